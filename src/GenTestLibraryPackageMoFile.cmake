@@ -7,3 +7,8 @@ else()
     file(REMOVE ${CMAKE_CURRENT_BINARY_DIR}/test_facit/Module/testLongName_01_567890_02_567890_03_567890_04_567890_05_567890_06_567890_07_567890_08_567890_09_567890_10_567890_11_567890_12_567890_13_567890_14_567890_15_567890.mo) 
 endif()
 
+
+# A model that spans several chunks of the chunked format (64 KiB each), for the tests that decrypt on several threads.
+string(REPEAT "    // Padding that makes this model span several chunks when encrypted in the chunked format.\n" 3000 TEST_LARGE_PADDING)
+file(WRITE ${CMAKE_CURRENT_BINARY_DIR}/test_facit/Module/testLarge.mo
+     "within test_library.Module;\nmodel testLarge\n${TEST_LARGE_PADDING}    Real x = time;\nend testLarge;\n")
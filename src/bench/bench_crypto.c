@@ -0,0 +1,409 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+/*
+ * bench_crypto runs the decryptor benchmark suite in bench_decryptor.c,
+ * and bench_crypto primitives the comparison below.
+ *
+ * Compare ways of decrypting and verifying .moc data in format 1
+ * (AES-256-CBC, HMAC-SHA256 over IV + plaintext) with format 2
+ * (AES-256-GCM), for a range of sizes:
+ *
+ *  two_pass - decrypt everything, then HMAC everything, as mlle_cr_decrypt
+ *             used to do.
+ *  fused    - decrypt and HMAC a chunk at a time, as mlle_cr_decrypt does
+ *             now, so that each chunk is MACed while still in cache.
+ *  gcm      - decrypt and verify format 2 (AES-256-GCM).
+ *
+ * Usage: bench_crypto primitives [-c <chunk bytes>] [<size in bytes> ...]
+ *
+ * Uses a random key, so no library or LVE is needed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* libcrypto-compat.h must be first */
+#include "libcrypto-compat.h"
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+
+#include "mlle_cr_crypt.h"
+#include "mlle_stats.h"
+#include "bench_decryptor.h"
+
+#define KEY_LEN (32)
+
+/* Same as DECRYPT_CHUNK_LEN in the default decryptor. */
+#define DEFAULT_CHUNK_LEN (64 * 1024)
+
+/* Bytes to process per size and method, to get stable timings. */
+#define BYTES_PER_RUN (128ULL * 1024 * 1024)
+
+static const size_t default_sizes[] = {
+    16 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024,
+    16 * 1024 * 1024, 64 * 1024 * 1024
+};
+
+struct bench_mac {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC *mac;
+    EVP_MAC_CTX *ctx;
+#else
+    HMAC_CTX *ctx;
+#endif
+};
+
+static int mac_new(struct bench_mac *mac)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    OSSL_PARAM params[2];
+
+    mac->mac = EVP_MAC_fetch(NULL, OSSL_MAC_NAME_HMAC, NULL);
+    mac->ctx = mac->mac ? EVP_MAC_CTX_new(mac->mac) : NULL;
+    if (mac->ctx == NULL) {
+        return 0;
+    }
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                                 (char *) EVP_MD_get0_name(MLLE_CR_HASH), 0);
+    params[1] = OSSL_PARAM_construct_end();
+    return EVP_MAC_CTX_set_params(mac->ctx, params);
+#else
+    mac->ctx = HMAC_CTX_new();
+    return mac->ctx != NULL;
+#endif
+}
+
+static void mac_free(struct bench_mac *mac)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX_free(mac->ctx);
+    EVP_MAC_free(mac->mac);
+#else
+    HMAC_CTX_free(mac->ctx);
+#endif
+}
+
+static int mac_init(struct bench_mac *mac, const unsigned char *key)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_MAC_init(mac->ctx, key, KEY_LEN, NULL);
+#else
+    return HMAC_Init_ex(mac->ctx, key, KEY_LEN, MLLE_CR_HASH, NULL);
+#endif
+}
+
+static int mac_update(struct bench_mac *mac, const unsigned char *data, size_t len)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_MAC_update(mac->ctx, data, len);
+#else
+    return HMAC_Update(mac->ctx, data, len);
+#endif
+}
+
+static int mac_final(struct bench_mac *mac, unsigned char *out)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    size_t len = 0;
+    return EVP_MAC_final(mac->ctx, out, &len, EVP_MAX_MD_SIZE);
+#else
+    unsigned int len = 0;
+    return HMAC_Final(mac->ctx, out, &len);
+#endif
+}
+
+/*
+ * Encrypt size random bytes into IV + ciphertext + HMAC.
+ * Returns the length of the encrypted data, 0 on failure.
+ */
+static size_t encrypt(EVP_CIPHER_CTX *ctx, struct bench_mac *mac,
+                      const unsigned char *key, size_t size,
+                      unsigned char *out)
+{
+    unsigned char *plain = malloc(size);
+    int iv_len = EVP_CIPHER_iv_length(MLLE_CR_CIPHER);
+    int len = 0;
+    size_t total = 0;
+
+    if (plain == NULL || !RAND_bytes(plain, (int) size) || !RAND_bytes(out, iv_len)) {
+        free(plain);
+        return 0;
+    }
+    total = iv_len;
+    if (!EVP_EncryptInit_ex(ctx, MLLE_CR_CIPHER, NULL, key, out)
+        || !EVP_EncryptUpdate(ctx, out + total, &len, plain, (int) size)) {
+        free(plain);
+        return 0;
+    }
+    total += len;
+    if (!EVP_EncryptFinal_ex(ctx, out + total, &len)) {
+        free(plain);
+        return 0;
+    }
+    total += len;
+    if (!mac_init(mac, key) || !mac_update(mac, out, iv_len)
+        || !mac_update(mac, plain, size) || !mac_final(mac, out + total)) {
+        free(plain);
+        return 0;
+    }
+    total += EVP_MD_size(MLLE_CR_HASH);
+    free(plain);
+    return total;
+}
+
+static int decrypt_two_pass(EVP_CIPHER_CTX *ctx, struct bench_mac *mac,
+                            const unsigned char *key,
+                            const unsigned char *in, size_t in_len,
+                            unsigned char *out)
+{
+    int iv_len = EVP_CIPHER_iv_length(MLLE_CR_CIPHER);
+    int mac_len = EVP_MD_size(MLLE_CR_HASH);
+    unsigned char computed[EVP_MAX_MD_SIZE];
+    int out_len = 0;
+    int len = 0;
+
+    if (!EVP_DecryptInit_ex(ctx, MLLE_CR_CIPHER, NULL, key, in)
+        || !EVP_DecryptUpdate(ctx, out, &len, in + iv_len, (int) (in_len - iv_len - mac_len))) {
+        return 0;
+    }
+    out_len = len;
+    if (!EVP_DecryptFinal_ex(ctx, out + out_len, &len)) {
+        return 0;
+    }
+    out_len += len;
+    if (!mac_init(mac, key) || !mac_update(mac, in, iv_len)
+        || !mac_update(mac, out, out_len) || !mac_final(mac, computed)) {
+        return 0;
+    }
+    return memcmp(computed, in + in_len - mac_len, mac_len) == 0;
+}
+
+static int decrypt_fused(EVP_CIPHER_CTX *ctx, struct bench_mac *mac,
+                         const unsigned char *key, size_t chunk,
+                         const unsigned char *in, size_t in_len,
+                         unsigned char *out)
+{
+    int iv_len = EVP_CIPHER_iv_length(MLLE_CR_CIPHER);
+    int block_len = EVP_CIPHER_block_size(MLLE_CR_CIPHER);
+    int mac_len = EVP_MD_size(MLLE_CR_HASH);
+    size_t enc_len = in_len - iv_len - mac_len;
+    unsigned char computed[EVP_MAX_MD_SIZE];
+    size_t pos = 0;
+    size_t n = 0;
+    int len = 0;
+    int pad = 0;
+
+    if (!EVP_DecryptInit_ex(ctx, MLLE_CR_CIPHER, NULL, key, in)) {
+        return 0;
+    }
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    if (!mac_init(mac, key) || !mac_update(mac, in, iv_len)) {
+        return 0;
+    }
+    for (pos = 0; pos < enc_len; pos += n) {
+        n = enc_len - pos < chunk ? enc_len - pos : chunk;
+        if (!EVP_DecryptUpdate(ctx, out + pos, &len, in + iv_len + pos, (int) n)
+            || !mac_update(mac, out + pos, pos + n == enc_len ? n - block_len : n)) {
+            return 0;
+        }
+    }
+    pad = out[enc_len - 1];
+    if (pad < 1 || pad > block_len
+        || !mac_update(mac, out + enc_len - block_len, block_len - pad)
+        || !mac_final(mac, computed)) {
+        return 0;
+    }
+    EVP_CIPHER_CTX_set_padding(ctx, 1);
+    return memcmp(computed, in + in_len - mac_len, mac_len) == 0;
+}
+
+/*
+ * Encrypt size random bytes in format 2, without the header, into
+ * nonce + ciphertext + tag. Returns the length, 0 on failure.
+ */
+static size_t encrypt_gcm(EVP_CIPHER_CTX *ctx, const unsigned char *key,
+                          size_t size, unsigned char *out)
+{
+    unsigned char *plain = malloc(size);
+    int len = 0;
+    size_t total = MLLE_CR_GCM_NONCE_LENGTH;
+
+    if (plain == NULL || !RAND_bytes(plain, (int) size)
+        || !RAND_bytes(out, MLLE_CR_GCM_NONCE_LENGTH)
+        || !EVP_EncryptInit_ex(ctx, MLLE_CR_GCM_CIPHER, NULL, key, out)
+        || !EVP_EncryptUpdate(ctx, out + total, &len, plain, (int) size)) {
+        free(plain);
+        return 0;
+    }
+    total += len;
+    free(plain);
+    if (!EVP_EncryptFinal_ex(ctx, out + total, &len)) {
+        return 0;
+    }
+    total += len;
+    if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, MLLE_CR_GCM_TAG_LENGTH, out + total)) {
+        return 0;
+    }
+    return total + MLLE_CR_GCM_TAG_LENGTH;
+}
+
+static int decrypt_gcm(EVP_CIPHER_CTX *ctx, const unsigned char *key,
+                       const unsigned char *in, size_t in_len,
+                       unsigned char *out)
+{
+    int enc_len = (int) (in_len - MLLE_CR_GCM_NONCE_LENGTH - MLLE_CR_GCM_TAG_LENGTH);
+    unsigned char tag[MLLE_CR_GCM_TAG_LENGTH];
+    int len = 0;
+
+    memcpy(tag, in + in_len - MLLE_CR_GCM_TAG_LENGTH, MLLE_CR_GCM_TAG_LENGTH);
+    return EVP_DecryptInit_ex(ctx, MLLE_CR_GCM_CIPHER, NULL, key, in)
+        && EVP_DecryptUpdate(ctx, out, &len, in + MLLE_CR_GCM_NONCE_LENGTH, enc_len)
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, MLLE_CR_GCM_TAG_LENGTH, tag)
+        && EVP_DecryptFinal_ex(ctx, out + len, &len);
+}
+
+enum bench_method {
+    BENCH_TWO_PASS,
+    BENCH_FUSED,
+    BENCH_GCM
+};
+
+/* Returns MB/s, or a negative value if decryption failed. */
+static double run(enum bench_method method, EVP_CIPHER_CTX *ctx, struct bench_mac *mac,
+                  const unsigned char *key, size_t chunk, size_t size,
+                  const unsigned char *in, size_t in_len, unsigned char *out)
+{
+    unsigned long long iterations = BYTES_PER_RUN / size;
+    unsigned long long i = 0;
+    mlle_stats_ns start = 0;
+    mlle_stats_ns elapsed = 0;
+    int ok = 1;
+
+    if (iterations < 3) {
+        iterations = 3;
+    }
+    start = mlle_stats_now();
+    for (i = 0; i < iterations && ok; i++) {
+        switch (method) {
+        case BENCH_TWO_PASS:
+            ok = decrypt_two_pass(ctx, mac, key, in, in_len, out);
+            break;
+        case BENCH_FUSED:
+            ok = decrypt_fused(ctx, mac, key, chunk, in, in_len, out);
+            break;
+        case BENCH_GCM:
+            ok = decrypt_gcm(ctx, key, in, in_len, out);
+            break;
+        }
+    }
+    elapsed = mlle_stats_now() - start;
+    if (!ok) {
+        return -1.0;
+    }
+    return (double) size * (double) iterations / (1024.0 * 1024.0)
+           / ((double) elapsed / 1e9);
+}
+
+/* argv[0] is the first option. */
+static int bench_primitives(int argc, char **argv)
+{
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    struct bench_mac mac = { 0 };
+    unsigned char key[KEY_LEN];
+    size_t chunk = DEFAULT_CHUNK_LEN;
+    size_t sizes[64];
+    size_t nsizes = 0;
+    size_t i = 0;
+    int result = EXIT_FAILURE;
+
+    for (i = 0; i < (size_t) argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < (size_t) argc) {
+            chunk = (size_t) strtoul(argv[++i], NULL, 10);
+            chunk -= chunk % EVP_CIPHER_block_size(MLLE_CR_CIPHER);
+        } else if (nsizes < sizeof(sizes) / sizeof(sizes[0])) {
+            sizes[nsizes++] = (size_t) strtoul(argv[i], NULL, 10);
+        }
+    }
+    if (nsizes == 0) {
+        nsizes = sizeof(default_sizes) / sizeof(default_sizes[0]);
+        memcpy(sizes, default_sizes, sizeof(default_sizes));
+    }
+    if (chunk == 0) {
+        fprintf(stderr, "Chunk size must be at least one cipher block\n");
+        return EXIT_FAILURE;
+    }
+
+    if (ctx == NULL || !mac_new(&mac) || !RAND_bytes(key, KEY_LEN)) {
+        fprintf(stderr, "Could not set up OpenSSL\n");
+        goto cleanup;
+    }
+
+    printf("%12s %16s %16s %16s\n", "bytes", "two_pass_MB/s", "fused_MB/s", "gcm_MB/s");
+    for (i = 0; i < nsizes; i++) {
+        size_t size = sizes[i];
+        size_t in_cap = size + 256;
+        unsigned char *in = malloc(in_cap);
+        unsigned char *in_gcm = malloc(in_cap);
+        unsigned char *out = malloc(in_cap);
+        size_t in_len = 0;
+        size_t in_gcm_len = 0;
+        double two_pass = 0.0;
+        double fused = 0.0;
+        double gcm = 0.0;
+
+        if (size == 0 || in == NULL || in_gcm == NULL || out == NULL
+            || (in_len = encrypt(ctx, &mac, key, size, in)) == 0
+            || (in_gcm_len = encrypt_gcm(ctx, key, size, in_gcm)) == 0) {
+            fprintf(stderr, "Could not set up data of size %lu\n", (unsigned long) size);
+            free(in);
+            free(in_gcm);
+            free(out);
+            goto cleanup;
+        }
+        /* Warm up, and touch all pages of out. */
+        decrypt_two_pass(ctx, &mac, key, in, in_len, out);
+
+        two_pass = run(BENCH_TWO_PASS, ctx, &mac, key, chunk, size, in, in_len, out);
+        fused = run(BENCH_FUSED, ctx, &mac, key, chunk, size, in, in_len, out);
+        gcm = run(BENCH_GCM, ctx, &mac, key, chunk, size, in_gcm, in_gcm_len, out);
+        free(in);
+        free(in_gcm);
+        free(out);
+        if (two_pass < 0 || fused < 0 || gcm < 0) {
+            fprintf(stderr, "Decryption failed for size %lu\n", (unsigned long) size);
+            goto cleanup;
+        }
+        printf("%12lu %16.1f %16.1f %16.1f\n", (unsigned long) size,
+               two_pass, fused, gcm);
+    }
+    result = EXIT_SUCCESS;
+
+cleanup:
+    mac_free(&mac);
+    EVP_CIPHER_CTX_free(ctx);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "primitives") == 0) {
+        return bench_primitives(argc - 2, argv + 2);
+    }
+    return bench_decryptor(argc - 1, argv + 1);
+}
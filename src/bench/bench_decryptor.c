@@ -0,0 +1,446 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+/*
+ * Throughput and latency of the decryptor (mlle_cr_encrypt_mem and
+ * mlle_cr_decrypt), for each encrypted file format, file size and
+ * directory depth:
+ *
+ *  encrypt - encrypt a file at the top level.
+ *  decrypt, warm - decrypt a file with a context that has the key masks of
+ *             its directories cached, as the LVE does for most files.
+ *  decrypt, cold - create a context and decrypt a file with it, so that
+ *             mlle_demask_key has to read and decrypt the package.moc of
+ *             every directory above the file.
+ *
+ * Usage: bench_crypto [-json <file>] [-w <work dir>] [-f <format>]...
+ *                     [-s <bytes>]... [-d <depth>]...
+ *
+ * The package.moc files are written to the work directory (default
+ * bench_crypto_work), the files measured are kept in memory. No LVE or
+ * license manager is needed.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include <openssl/opensslv.h>
+
+#include "mlle_cr_decrypt.h"
+#include "mlle_cr_encrypt.h"
+#include "mlle_stats.h"
+#include "mlle_thread.h"
+#include "bench_decryptor.h"
+
+/* Bytes to process per measurement, within the iteration limits below. */
+#define BYTES_PER_RUN (64ULL * 1024 * 1024)
+#define MIN_ITERATIONS (3)
+#define MAX_ITERATIONS (10000)
+
+#define MAX_DEPTH (32)
+#define MAX_VALUES (64)
+#define PATH_LEN (1024)
+
+static const size_t default_sizes[] = {
+    1024, 4 * 1024, 16 * 1024, 64 * 1024, 256 * 1024,
+    1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024,
+    64 * 1024 * 1024, 256 * 1024 * 1024
+};
+static const int default_depths[] = { 0, 1, 8 };
+static const int default_formats[] = {
+    MLLE_CR_FORMAT_CBC_HMAC, MLLE_CR_FORMAT_GCM, MLLE_CR_FORMAT_GCM_CHUNKED
+};
+
+struct bench_result {
+    const char *op;
+    int format;
+    size_t bytes;
+    int depth;
+    const char *cache;
+    unsigned long iterations;
+    double mb_per_s;
+    double latency_us;
+};
+
+struct bench_results {
+    struct bench_result *results;
+    size_t count;
+    size_t cap;
+};
+
+static int make_dir(const char *path)
+{
+#ifdef _WIN32
+    if (_mkdir(path) != 0 && errno != EEXIST) {
+#else
+    if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+#endif
+        fprintf(stderr, "Could not create directory %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+/* Relative path of directory level depth, "" for the top level, else "d1/d2/.../d<depth>/". */
+static void level_path(int depth, char *path, size_t len)
+{
+    int i = 0;
+    size_t pos = 0;
+
+    path[0] = '\0';
+    for (i = 1; i <= depth && pos < len; i++) {
+        pos += snprintf(path + pos, len - pos, "d%d/", i);
+    }
+}
+
+/*
+ * Create base/package.moc, base/d1/package.moc, ... down to depth max_depth,
+ * encrypted in the format set for context. Returns 1 on success and 0 on failure.
+ */
+static int write_library(mlle_cr_context *context, const char *base, int max_depth)
+{
+    static const char package[] = "package P\nend P;\n";
+    char level[PATH_LEN];
+    char rel[PATH_LEN];
+    char path[PATH_LEN];
+    char buf[256];
+    size_t len = 0;
+    FILE *out = NULL;
+    int depth = 0;
+    int ok = 0;
+
+    for (depth = 0; depth <= max_depth; depth++) {
+        level_path(depth, level, sizeof(level));
+        if (snprintf(path, sizeof(path), "%s/%s", base, level) >= (int) sizeof(path)) {
+            fprintf(stderr, "Path too long: %s/%s\n", base, level);
+            return 0;
+        }
+        if (!make_dir(path)) {
+            return 0;
+        }
+        snprintf(rel, sizeof(rel), "%spackage.mo", level);
+        len = mlle_cr_encrypt_mem(context, rel, package, sizeof(package) - 1, buf, sizeof(buf));
+        if (len == 0) {
+            fprintf(stderr, "Could not encrypt %s\n", rel);
+            return 0;
+        }
+        if (snprintf(path, sizeof(path), "%s/%spackage.moc", base, level) >= (int) sizeof(path)) {
+            fprintf(stderr, "Path too long: %s/%spackage.moc\n", base, level);
+            return 0;
+        }
+        out = fopen(path, "wb");
+        ok = out != NULL && fwrite(buf, 1, len, out) == len;
+        if (out != NULL && fclose(out) != 0) {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "Could not write %s: %s\n", path, strerror(errno));
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int add_result(struct bench_results *results, const char *op, int format,
+                      size_t bytes, int depth, const char *cache,
+                      unsigned long iterations, mlle_stats_ns elapsed)
+{
+    struct bench_result *r = NULL;
+    double seconds = (double) (elapsed ? elapsed : 1) / 1e9;
+
+    if (results->count == results->cap) {
+        size_t cap = results->cap ? 2 * results->cap : 64;
+        r = realloc(results->results, cap * sizeof(*r));
+        if (r == NULL) {
+            return 0;
+        }
+        results->results = r;
+        results->cap = cap;
+    }
+    r = &results->results[results->count++];
+    r->op = op;
+    r->format = format;
+    r->bytes = bytes;
+    r->depth = depth;
+    r->cache = cache;
+    r->iterations = iterations;
+    r->mb_per_s = (double) bytes * (double) iterations / (1024.0 * 1024.0) / seconds;
+    r->latency_us = seconds * 1e6 / (double) iterations;
+
+    printf("%-8s %6d %12lu %6d %6s %10lu %12.1f %14.1f\n", op, format,
+           (unsigned long) bytes, depth, cache, iterations, r->mb_per_s, r->latency_us);
+    fflush(stdout);
+    return 1;
+}
+
+static void write_json(FILE *out, const struct bench_results *results)
+{
+    size_t i = 0;
+
+    fprintf(out, "{\"benchmark\":\"bench_crypto\",\"openssl\":\"%s\",\"cpus\":%d,\"results\":[",
+            OPENSSL_VERSION_TEXT, mlle_thread_cpu_count());
+    for (i = 0; i < results->count; i++) {
+        const struct bench_result *r = &results->results[i];
+        fprintf(out, "%s\n{\"op\":\"%s\",\"format\":%d,\"bytes\":%lu,\"depth\":%d,"
+                "\"cache\":\"%s\",\"iterations\":%lu,\"mb_per_s\":%.1f,\"latency_us\":%.2f}",
+                i ? "," : "", r->op, r->format, (unsigned long) r->bytes, r->depth,
+                r->cache, r->iterations, r->mb_per_s, r->latency_us);
+    }
+    fprintf(out, "\n]}\n");
+}
+
+static unsigned long iterations_for(size_t size)
+{
+    unsigned long long n = BYTES_PER_RUN / (size ? size : 1);
+
+    if (n < MIN_ITERATIONS) {
+        n = MIN_ITERATIONS;
+    }
+    if (n > MAX_ITERATIONS) {
+        n = MAX_ITERATIONS;
+    }
+    return (unsigned long) n;
+}
+
+/*
+ * Measure one format and size: encryption at the top level, and warm and
+ * cold decryption at each depth. Returns 1 on success and 0 on failure.
+ */
+static int bench_size(const char *base, int format, size_t size,
+                      const int *depths, size_t ndepths,
+                      struct bench_results *results)
+{
+    mlle_cr_context *context = mlle_cr_create(base);
+    char *plain = malloc(size ? size : 1);
+    char *enc = NULL;
+    char *out = NULL;
+    char level[PATH_LEN];
+    char rel[PATH_LEN];
+    size_t cap = 0;
+    size_t enc_len = 0;
+    unsigned long iterations = iterations_for(size);
+    unsigned long i = 0;
+    mlle_stats_ns start = 0;
+    size_t d = 0;
+    int ok = 0;
+
+    if (context == NULL || plain == NULL || !mlle_cr_set_format(context, format)) {
+        goto cleanup;
+    }
+    for (i = 0; i < size; i++) {
+        plain[i] = (char) (i * 31 + (i >> 12));
+    }
+    cap = mlle_cr_encrypt_mem_size(context, "f.mo", size);
+    enc = malloc(cap);
+    out = malloc(cap);
+    if (enc == NULL || out == NULL) {
+        fprintf(stderr, "Out of memory for size %lu\n", (unsigned long) size);
+        goto cleanup;
+    }
+
+    /* Encryption. The key masks are read from the package.moc files as encrypt_file does,
+       and the first call is not measured. */
+    if (mlle_cr_decrypt(context, "f.moc", NULL, 0, NULL) < 0
+        || mlle_cr_encrypt_mem(context, "f.mo", plain, size, enc, cap) != cap) {
+        goto cleanup;
+    }
+    start = mlle_stats_now();
+    for (i = 0; i < iterations; i++) {
+        if (mlle_cr_encrypt_mem(context, "f.mo", plain, size, enc, cap) != cap) {
+            goto cleanup;
+        }
+    }
+    if (!add_result(results, "encrypt", format, size, 0, "warm", iterations,
+                    mlle_stats_now() - start)) {
+        goto cleanup;
+    }
+
+    for (d = 0; d < ndepths; d++) {
+        mlle_cr_context *warm = NULL;
+
+        level_path(depths[d], level, sizeof(level));
+        snprintf(rel, sizeof(rel), "%sf.moc", level);
+        if (mlle_cr_decrypt(context, rel, NULL, 0, NULL) < 0) {
+            goto cleanup;
+        }
+        rel[strlen(rel) - 1] = '\0';
+        enc_len = mlle_cr_encrypt_mem(context, rel, plain, size, enc, cap);
+        if (enc_len != cap) {
+            goto cleanup;
+        }
+        strcat(rel, "c");
+
+        /* Warm: the first call fills the cache and is checked. */
+        warm = mlle_cr_create(base);
+        if (warm == NULL || mlle_cr_decrypt(warm, rel, enc, enc_len, out) != (int) size
+            || memcmp(out, plain, size) != 0) {
+            fprintf(stderr, "Decryption of %s failed\n", rel);
+            mlle_cr_free(warm);
+            goto cleanup;
+        }
+        start = mlle_stats_now();
+        for (i = 0; i < iterations; i++) {
+            if (mlle_cr_decrypt(warm, rel, enc, enc_len, out) != (int) size) {
+                break;
+            }
+        }
+        mlle_cr_free(warm);
+        if (i < iterations || !add_result(results, "decrypt", format, size, depths[d],
+                                          "warm", iterations, mlle_stats_now() - start)) {
+            goto cleanup;
+        }
+
+        /* Cold: a new context for every file. */
+        start = mlle_stats_now();
+        for (i = 0; i < iterations; i++) {
+            mlle_cr_context *cold = mlle_cr_create(base);
+            int len = cold ? mlle_cr_decrypt(cold, rel, enc, enc_len, out) : -1;
+
+            mlle_cr_free(cold);
+            if (len != (int) size) {
+                break;
+            }
+        }
+        if (i < iterations || !add_result(results, "decrypt", format, size, depths[d],
+                                          "cold", iterations, mlle_stats_now() - start)) {
+            goto cleanup;
+        }
+    }
+    ok = 1;
+
+cleanup:
+    mlle_cr_free(context);
+    free(plain);
+    free(enc);
+    free(out);
+    return ok;
+}
+
+int bench_decryptor(int argc, char **argv)
+{
+    struct bench_results results = { 0 };
+    const char *json = NULL;
+    const char *work = "bench_crypto_work";
+    char base[PATH_LEN];
+    size_t sizes[MAX_VALUES];
+    int depths[MAX_VALUES];
+    int formats[MAX_VALUES];
+    size_t nsizes = 0;
+    size_t ndepths = 0;
+    size_t nformats = 0;
+    int max_depth = 0;
+    size_t f = 0;
+    size_t s = 0;
+    int i = 0;
+    int result = EXIT_FAILURE;
+    FILE *out = NULL;
+
+    for (i = 0; i < argc; i++) {
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "-json") == 0) {
+            json = argv[++i];
+        } else if (strcmp(argv[i], "-w") == 0) {
+            work = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 && nformats < MAX_VALUES) {
+            formats[nformats++] = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && nsizes < MAX_VALUES) {
+            sizes[nsizes++] = (size_t) strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-d") == 0 && ndepths < MAX_VALUES) {
+            depths[ndepths] = atoi(argv[++i]);
+            if (depths[ndepths] < 0 || depths[ndepths] > MAX_DEPTH) {
+                fprintf(stderr, "Depth must be 0 to %d\n", MAX_DEPTH);
+                return EXIT_FAILURE;
+            }
+            ndepths++;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (nsizes == 0) {
+        nsizes = sizeof(default_sizes) / sizeof(default_sizes[0]);
+        memcpy(sizes, default_sizes, sizeof(default_sizes));
+    }
+    if (ndepths == 0) {
+        ndepths = sizeof(default_depths) / sizeof(default_depths[0]);
+        memcpy(depths, default_depths, sizeof(default_depths));
+    }
+    if (nformats == 0) {
+        nformats = sizeof(default_formats) / sizeof(default_formats[0]);
+        memcpy(formats, default_formats, sizeof(default_formats));
+    }
+    for (s = 0; s < ndepths; s++) {
+        if (depths[s] > max_depth) {
+            max_depth = depths[s];
+        }
+    }
+
+    if (!make_dir(work)) {
+        return EXIT_FAILURE;
+    }
+    printf("%-8s %6s %12s %6s %6s %10s %12s %14s\n", "op", "format", "bytes",
+           "depth", "cache", "iterations", "MB/s", "latency_us");
+    for (f = 0; f < nformats; f++) {
+        mlle_cr_context *context = NULL;
+
+        /* Each format gets a library of its own, since the key masks differ. */
+        snprintf(base, sizeof(base), "%s/format%d", work, formats[f]);
+        context = mlle_cr_create(base);
+        if (context == NULL || !mlle_cr_set_format(context, formats[f])) {
+            fprintf(stderr, "Format %d is not supported\n", formats[f]);
+            mlle_cr_free(context);
+            goto cleanup;
+        }
+        if (!make_dir(base) || !write_library(context, base, max_depth)) {
+            mlle_cr_free(context);
+            goto cleanup;
+        }
+        mlle_cr_free(context);
+
+        for (s = 0; s < nsizes; s++) {
+            if (!bench_size(base, formats[f], sizes[s], depths, ndepths, &results)) {
+                fprintf(stderr, "Benchmark of format %d, size %lu failed\n",
+                        formats[f], (unsigned long) sizes[s]);
+                goto cleanup;
+            }
+        }
+    }
+
+    if (json != NULL) {
+        out = fopen(json, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Could not open %s: %s\n", json, strerror(errno));
+            goto cleanup;
+        }
+        write_json(out, &results);
+        if (fclose(out) != 0) {
+            fprintf(stderr, "Could not write %s\n", json);
+            goto cleanup;
+        }
+    }
+    result = EXIT_SUCCESS;
+
+cleanup:
+    free(results.results);
+    return result;
+}
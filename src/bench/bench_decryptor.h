@@ -0,0 +1,34 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+#ifndef BENCH_DECRYPTOR_H_
+#define BENCH_DECRYPTOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/************************************************************
+ * Run the decryptor benchmark suite, see bench_decryptor.c.
+ * argv[0] is the first option.
+ *
+ * Returns:
+ *      EXIT_SUCCESS or EXIT_FAILURE.
+ ***********************************************************/
+int
+bench_decryptor(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BENCH_DECRYPTOR_H_ */
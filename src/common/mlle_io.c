@@ -33,6 +33,8 @@
 #include "mlle_io.h"
 #include "mlle_protocol.h"
 #include "mlle_ssl.h"
+#include "mlle_stats.h"
+#include "mlle_trace.h"
 
 #ifdef _WIN32
 #define stat _stat
@@ -52,6 +54,7 @@ void mlle_log_open(const char *envvar)
         time(&timer);
         localtime(&timer);
         fprintf(mlle_log, "Opening logfile at: %s\n", ctime(&timer));
+        mlle_trace_enable();
     }
 }
 
@@ -170,6 +173,19 @@ char *mlle_io_read_file(const char *file_path, size_t *file_size,
     return file_buffer;
 }
 
+/***************************************
+ * Write a complete message, recording time and bytes.
+ ***************************************/
+static int mlle_io_write_message(SSL *ssl, char *message, size_t length)
+{
+    mlle_stats_ns start = mlle_stats_now();
+    int result = ssl_write_message(ssl, message, length);
+
+    mlle_stats_phase(MLLE_STATS_PHASE_TLS_WRITE, start);
+    mlle_stats_count(MLLE_STATS_BYTES_SENT, length);
+    return result;
+}
+
 /***************************************
  * Send message of form "<COMMAND>LF".
  ***************************************/
@@ -183,7 +199,7 @@ void mlle_send_simple_form(SSL *ssl, enum mlle_protocol_command_id command_id)
                       mlle_command_info[command_id].name);
 
     if (result >= 0) {
-        ssl_write_message(ssl, output, strlen(output));
+        mlle_io_write_message(ssl, output, strlen(output));
     }
 }
 
@@ -201,7 +217,7 @@ int mlle_send_number_form(SSL *ssl, enum mlle_protocol_command_id command_id,
                       mlle_command_info[command_id].name, number);
 
     if (result >= 0) {
-        result = ssl_write_message(ssl, output, strlen(output));
+        result = mlle_io_write_message(ssl, output, strlen(output));
     }
     return result;
 }
@@ -214,6 +230,7 @@ void mlle_send_length_form(SSL *ssl, enum mlle_protocol_command_id command_id,
     size_t message_length = 0;
     char *output = NULL;
     size_t output_length;
+    mlle_stats_ns start = mlle_stats_now();
 
     // The buffer contains command, length of data and the data.
     output_length = NUMBER_FORM_BUFFER_SIZE + length + 1;
@@ -230,9 +247,10 @@ void mlle_send_length_form(SSL *ssl, enum mlle_protocol_command_id command_id,
         // Add data to array.
         memcpy(output + print_result, data, length);
         message_length = length + print_result;
+        mlle_stats_phase(MLLE_STATS_PHASE_FRAMING, start);
 
         // Send array
-        ssl_write_message(ssl, output, message_length);
+        mlle_io_write_message(ssl, output, message_length);
     }
 
     memset(output, 0, message_length);
@@ -256,6 +274,7 @@ void mlle_send_number_and_length_form(SSL *ssl,
     size_t message_length = 0;
     char *output = NULL;
     size_t output_length;
+    mlle_stats_ns start = mlle_stats_now();
 
     // The buffer contains command, length of data and the data.
     output_length = NUMBER_AND_LENGTH_FORM_BUFFER_SIZE + length + 1;
@@ -273,9 +292,10 @@ void mlle_send_number_and_length_form(SSL *ssl,
         // Add data to array.
         memcpy(output + print_result, data, length);
         message_length = length + print_result;
+        mlle_stats_phase(MLLE_STATS_PHASE_FRAMING, start);
 
         // Send array
-        ssl_write_message(ssl, output, message_length);
+        mlle_io_write_message(ssl, output, message_length);
     }
 
     memset(output, 0, message_length);
@@ -33,12 +33,14 @@ const struct mlle_command_info mlle_command_info[MLLE_PROTOCOL_COMMAND_ID_SIZE]
     { MLLE_PROTOCOL_NOTSIMPLE_CMD,     MLLE_PROTOCOL_SIMPLE_MSG_FORM,            "NOTSIMPLE" },
     { MLLE_PROTOCOL_TOOLS_CMD,         MLLE_PROTOCOL_SIMPLE_MSG_FORM,            "TOOLS" },
     { MLLE_PROTOCOL_YES_CMD,           MLLE_PROTOCOL_SIMPLE_MSG_FORM,            "YES" },
+    { MLLE_PROTOCOL_STATS_CMD,         MLLE_PROTOCOL_SIMPLE_MSG_FORM,            "STATS" },
 
     /* Commands of number form. */
     { MLLE_PROTOCOL_VERSION_CMD,       MLLE_PROTOCOL_NUMBER_MSG_FORM,            "VERSION" },
 
     /* Commands of length form. */
     { MLLE_PROTOCOL_FEATURE_CMD,       MLLE_PROTOCOL_LENGTH_MSG_FORM,            "FEATURE" },
+    { MLLE_PROTOCOL_FEATURES_CMD,      MLLE_PROTOCOL_LENGTH_MSG_FORM,            "FEATURES" },
     { MLLE_PROTOCOL_FILE_CMD,          MLLE_PROTOCOL_LENGTH_MSG_FORM,            "FILE" },
     { MLLE_PROTOCOL_FILECONT_CMD,      MLLE_PROTOCOL_LENGTH_MSG_FORM,            "FILECONT" },
     { MLLE_PROTOCOL_LIB_CMD,           MLLE_PROTOCOL_LENGTH_MSG_FORM,            "LIB" },
@@ -47,6 +49,7 @@ const struct mlle_command_info mlle_command_info[MLLE_PROTOCOL_COMMAND_ID_SIZE]
     //{ MLLE_PROTOCOL_PUBKEY_CMD,        MLLE_PROTOCOL_LENGTH_MSG_FORM,            "PUBKEY" },
     { MLLE_PROTOCOL_RETURNFEATURE_CMD, MLLE_PROTOCOL_LENGTH_MSG_FORM,            "RETURNFEATURE" },
     { MLLE_PROTOCOL_RETURNLICENSE_CMD, MLLE_PROTOCOL_LENGTH_MSG_FORM,            "RETURNLICENSE" },
+    { MLLE_PROTOCOL_STATSCONT_CMD,     MLLE_PROTOCOL_LENGTH_MSG_FORM,            "STATSCONT" },
     { MLLE_PROTOCOL_TOOLLIST_CMD,      MLLE_PROTOCOL_LENGTH_MSG_FORM,            "TOOLLIST" },
 
     /* Commands of number and length form. */
@@ -47,8 +47,10 @@ enum mlle_protocol_command_id {
     MLLE_PROTOCOL_NOTSIMPLE_CMD,
     MLLE_PROTOCOL_TOOLS_CMD,
     MLLE_PROTOCOL_YES_CMD,
+    MLLE_PROTOCOL_STATS_CMD,
     MLLE_PROTOCOL_VERSION_CMD,
     MLLE_PROTOCOL_FEATURE_CMD,
+    MLLE_PROTOCOL_FEATURES_CMD,
     MLLE_PROTOCOL_FILE_CMD,
     MLLE_PROTOCOL_FILECONT_CMD,
     MLLE_PROTOCOL_LIB_CMD,
@@ -56,6 +58,7 @@ enum mlle_protocol_command_id {
     MLLE_PROTOCOL_NO_CMD,
     MLLE_PROTOCOL_RETURNFEATURE_CMD,
     MLLE_PROTOCOL_RETURNLICENSE_CMD,
+    MLLE_PROTOCOL_STATSCONT_CMD,
     MLLE_PROTOCOL_TOOLLIST_CMD,
     MLLE_PROTOCOL_ERROR_CMD,
 
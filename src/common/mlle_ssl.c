@@ -37,8 +37,10 @@
 #include "mlle_lve.h"
 #include "mlle_ssl.h"
 #include "mlle_error.h"
+#include "mlle_trace.h"
 
-char *global_tool_pub_key;
+unsigned char global_tool_pub_key_fingerprint[MLLE_SSL_FINGERPRINT_LEN];
+int global_tool_pub_key_received;
 
 /*****************************
  * Initiate the SSL library.
@@ -150,6 +152,31 @@ RSA* get_rsa(char *private_key)
 }
 
 
+/********************************************************************
+ * Hash the DER encoding of the public key of a certificate.
+ * The encoding is the one received, so the key is not parsed.
+ *
+ * Returns:
+ *      1 if successful, 0 otherwise.
+ *******************************************************************/
+int get_public_key_fingerprint(X509 *x509, unsigned char *fingerprint)
+{
+    unsigned char *der = NULL;
+    int der_len = 0;
+    int result = 0;
+
+    der_len = i2d_X509_PUBKEY(X509_get_X509_PUBKEY(x509), &der);
+    if (der_len <= 0)
+    {
+        return 0;
+    }
+    result = EVP_Digest(der, der_len, fingerprint, NULL, EVP_sha256(), NULL);
+    OPENSSL_free(der);
+
+    return result;
+}
+
+
 /********************************************************************
  * Extract the public key from an RSA structure to a char array.
  * The key is extracted in PEM format (base64 encoded data).
@@ -279,6 +306,8 @@ int ssl_write_message(SSL *ssl, char *message, size_t len)
         }
     }
 
+    mlle_trace(MLLE_TRACE_SSL_WRITE, (long long) len, bytes, 0);
+
     // If write is successful we get number of bytes written as result.
     if (bytes <= 0)
     {
@@ -358,6 +387,7 @@ int ssl_read_message(SSL *ssl, char **messageBuffer, int *errorCode)
             else
             {
                 // Client has shutdown, I/O error or similar.
+                mlle_trace(MLLE_TRACE_SSL_READ, errorResult, *errorCode, 0);
                 return errorResult;
             }
         }
@@ -405,6 +435,7 @@ int ssl_read_message(SSL *ssl, char **messageBuffer, int *errorCode)
 
     // Pass back pointer to message buffer.
     *messageBuffer = buffer;
+    mlle_trace(MLLE_TRACE_SSL_READ, totalBytesRead, 0, 0);
 
     return totalBytesRead;
 }
@@ -31,9 +31,13 @@
 struct mlle_lve_ctx;
 struct mlle_error;
 
-// Storage of the public key for the Tool
+// Length of a public key fingerprint, see get_public_key_fingerprint.
+#define MLLE_SSL_FINGERPRINT_LEN 32
+
+// Fingerprint of the public key for the Tool
 // which we receive in the LVE callback method.
-extern char *global_tool_pub_key;
+extern unsigned char global_tool_pub_key_fingerprint[MLLE_SSL_FINGERPRINT_LEN];
+extern int global_tool_pub_key_received;
 
 /*****************************
  * Initiate the SSL library.
@@ -58,6 +62,20 @@ RSA* get_rsa(char *private_key);
  *******************************************************************/
 char* get_public_key(RSA *rsa);
 
+/********************************************************************
+ * Get the SHA-256 fingerprint of the DER encoded public key
+ * (SubjectPublicKeyInfo) of a certificate, as generated for the
+ * trusted keys by fingerprint_keys.
+ *
+ * Parameters:
+ *      x509 - the certificate.
+ *      fingerprint - receives MLLE_SSL_FINGERPRINT_LEN bytes.
+ *
+ * Returns:
+ *      1 if successful, 0 otherwise.
+ *******************************************************************/
+int get_public_key_fingerprint(X509 *x509, unsigned char *fingerprint);
+
 
 /************************************************************
  * Generate a X509 certificate.
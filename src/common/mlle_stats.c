@@ -0,0 +1,287 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+#define _XOPEN_SOURCE 700
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+/* mlle_portability.h must be first */
+#include "mlle_portability.h"
+#include "mlle_stats.h"
+
+/* Values below 8 get a bucket each, after that 8 buckets per power of 2. */
+#define SUB_BUCKET_BITS (3)
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS (SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS)
+
+struct mlle_stats_histogram {
+    unsigned long long count;
+    mlle_stats_ns total;
+    mlle_stats_ns min;
+    mlle_stats_ns max;
+    unsigned long long buckets[HISTOGRAM_BUCKETS];
+};
+
+static int stats_enabled = 0;
+static struct mlle_stats_histogram command_histograms[MLLE_PROTOCOL_COMMAND_ID_SIZE];
+static struct mlle_stats_histogram phase_histograms[MLLE_STATS_PHASE_SIZE];
+static unsigned long long counters[MLLE_STATS_COUNTER_SIZE];
+static mlle_stats_ns startup_times[MLLE_STATS_STARTUP_SIZE];
+
+static const char *phase_names[MLLE_STATS_PHASE_SIZE] = {
+    "file_read", "demask", "decrypt", "framing", "tls_write", "license"
+};
+
+static const char *startup_names[MLLE_STATS_STARTUP_SIZE] = {
+    "init_ssl", "key_parse", "x509", "accept", "pubkey"
+};
+
+static const char *counter_names[MLLE_STATS_COUNTER_SIZE] = {
+    "bytes_received", "bytes_sent", "file_bytes_read", "files_served",
+    "files_decrypted", "feature_cache_hits", "feature_cache_misses"
+};
+
+void mlle_stats_enable(void)
+{
+    stats_enabled = 1;
+}
+
+int mlle_stats_enabled(void)
+{
+    return stats_enabled;
+}
+
+mlle_stats_ns mlle_stats_now(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (mlle_stats_ns) ((double) counter.QuadPart * 1e9 / (double) frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (mlle_stats_ns) ts.tv_sec * 1000000000ULL + (mlle_stats_ns) ts.tv_nsec;
+#endif
+}
+
+static int bucket_index(mlle_stats_ns value)
+{
+    int exponent = 0;
+
+    if (value < SUB_BUCKETS) {
+        return (int) value;
+    }
+    while ((value >> exponent) >= 2 * SUB_BUCKETS) {
+        exponent++;
+    }
+    /* value >> exponent is now in [SUB_BUCKETS, 2 * SUB_BUCKETS) */
+    return SUB_BUCKETS + exponent * SUB_BUCKETS
+        + (int) ((value >> exponent) - SUB_BUCKETS);
+}
+
+/* Largest value that falls in the bucket. */
+static mlle_stats_ns bucket_upper(int index)
+{
+    int exponent = 0;
+    mlle_stats_ns base = 0;
+
+    if (index < SUB_BUCKETS) {
+        return (mlle_stats_ns) index;
+    }
+    exponent = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    base = (mlle_stats_ns) (SUB_BUCKETS + (index - SUB_BUCKETS) % SUB_BUCKETS);
+    return ((base + 1) << exponent) - 1;
+}
+
+static void histogram_add(struct mlle_stats_histogram *histogram,
+                          mlle_stats_ns value)
+{
+    if (histogram->count == 0 || value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+    histogram->count++;
+    histogram->total += value;
+    histogram->buckets[bucket_index(value)]++;
+}
+
+static mlle_stats_ns histogram_percentile(const struct mlle_stats_histogram *histogram,
+                                          double percentile)
+{
+    unsigned long long rank = (unsigned long long) (percentile / 100.0 * (double) histogram->count);
+    unsigned long long seen = 0;
+    int i = 0;
+
+    if (rank >= histogram->count) {
+        return histogram->max;
+    }
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen > rank) {
+            mlle_stats_ns upper = bucket_upper(i);
+            return upper < histogram->max ? upper : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void mlle_stats_command(enum mlle_protocol_command_id command_id,
+                        mlle_stats_ns start)
+{
+    if (!stats_enabled) {
+        return;
+    }
+    histogram_add(&command_histograms[command_id], mlle_stats_now() - start);
+}
+
+void mlle_stats_phase(enum mlle_stats_phase phase, mlle_stats_ns start)
+{
+    if (!stats_enabled) {
+        return;
+    }
+    histogram_add(&phase_histograms[phase], mlle_stats_now() - start);
+}
+
+void mlle_stats_startup(enum mlle_stats_startup step, mlle_stats_ns start)
+{
+    if (!stats_enabled) {
+        return;
+    }
+    startup_times[step] = mlle_stats_now() - start;
+}
+
+void mlle_stats_count(enum mlle_stats_counter counter,
+                      unsigned long long amount)
+{
+    if (!stats_enabled) {
+        return;
+    }
+    counters[counter] += amount;
+}
+
+/* snprintf into buffer at offset, never past size. */
+static size_t append(char *buffer, size_t size, size_t offset,
+                     const char *format, ...)
+{
+    va_list args;
+    int n = 0;
+
+    va_start(args, format);
+    if (buffer != NULL && offset < size) {
+        n = vsnprintf(buffer + offset, size - offset, format, args);
+    } else {
+        n = vsnprintf(NULL, 0, format, args);
+    }
+    va_end(args);
+
+    return n > 0 ? (size_t) n : 0;
+}
+
+size_t mlle_stats_format(char *buffer, size_t size)
+{
+    size_t length = 0;
+    int i = 0;
+
+    if (buffer != NULL && size > 0) {
+        buffer[0] = '\0';
+    }
+    for (i = 0; i < MLLE_STATS_COUNTER_SIZE; i++) {
+        length += append(buffer, size, length, "%s=%llu\n",
+                         counter_names[i], counters[i]);
+    }
+    for (i = 0; i < MLLE_STATS_PHASE_SIZE; i++) {
+        const struct mlle_stats_histogram *histogram = &phase_histograms[i];
+
+        length += append(buffer, size, length,
+                         "%s_count=%llu\n%s_total_ns=%llu\n"
+                         "%s_p50_ns=%llu\n%s_p99_ns=%llu\n",
+                         phase_names[i], histogram->count,
+                         phase_names[i], histogram->total,
+                         phase_names[i], histogram_percentile(histogram, 50.0),
+                         phase_names[i], histogram_percentile(histogram, 99.0));
+    }
+    for (i = 0; i < MLLE_STATS_STARTUP_SIZE; i++) {
+        length += append(buffer, size, length, "startup_%s_ns=%llu\n",
+                         startup_names[i], startup_times[i]);
+    }
+    for (i = 0; i < MLLE_PROTOCOL_COMMAND_ID_SIZE; i++) {
+        const struct mlle_stats_histogram *histogram = &command_histograms[i];
+
+        if (histogram->count > 0) {
+            length += append(buffer, size, length,
+                             "cmd_%s_count=%llu\ncmd_%s_total_ns=%llu\n",
+                             mlle_command_info[i].name, histogram->count,
+                             mlle_command_info[i].name, histogram->total);
+        }
+    }
+
+    return length;
+}
+
+static void write_histogram(FILE *out, const char *name,
+                            const struct mlle_stats_histogram *histogram)
+{
+    fprintf(out,
+            "\"%s\":{\"count\":%llu,\"total_ns\":%llu,\"min_ns\":%llu,"
+            "\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}",
+            name, histogram->count, histogram->total, histogram->min,
+            histogram_percentile(histogram, 50.0),
+            histogram_percentile(histogram, 90.0),
+            histogram_percentile(histogram, 99.0),
+            histogram->max);
+}
+
+void mlle_stats_write_json(FILE *out)
+{
+    int i = 0;
+    int n = 0;
+
+    if (out == NULL) {
+        return;
+    }
+
+    fprintf(out, "{\"commands\":{");
+    for (i = 0; i < MLLE_PROTOCOL_COMMAND_ID_SIZE; i++) {
+        if (command_histograms[i].count > 0) {
+            fputs(n++ ? "," : "", out);
+            write_histogram(out, mlle_command_info[i].name, &command_histograms[i]);
+        }
+    }
+    fprintf(out, "},\"phases\":{");
+    n = 0;
+    for (i = 0; i < MLLE_STATS_PHASE_SIZE; i++) {
+        if (phase_histograms[i].count > 0) {
+            fputs(n++ ? "," : "", out);
+            write_histogram(out, phase_names[i], &phase_histograms[i]);
+        }
+    }
+    fprintf(out, "},\"startup_ns\":{");
+    for (i = 0; i < MLLE_STATS_STARTUP_SIZE; i++) {
+        fprintf(out, "%s\"%s\":%llu", i ? "," : "", startup_names[i], startup_times[i]);
+    }
+    fprintf(out, "},\"counters\":{");
+    for (i = 0; i < MLLE_STATS_COUNTER_SIZE; i++) {
+        fprintf(out, "%s\"%s\":%llu", i ? "," : "", counter_names[i], counters[i]);
+    }
+    fprintf(out, "}}\n");
+    fflush(out);
+}
@@ -0,0 +1,120 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+#ifndef MLLE_STATS_H_
+#define MLLE_STATS_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include "mlle_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Process wide performance counters, in the same spirit as mlle_log:
+ * nothing is recorded until mlle_stats_enable() is called, so programs
+ * other than the LVE (encrypt_file, packagetool, ...) pay nothing.
+ *
+ * Latencies are kept in log-linear histograms with 8 sub-buckets per
+ * power of two, i.e. with a relative error below 12.5%, from 1 ns up.
+ *
+ * Recording is not thread safe; only the LVE's main thread records.
+ */
+
+typedef unsigned long long mlle_stats_ns;
+
+/*
+ * Phases of serving a request. Timers are inclusive: DEMASK includes
+ * reading and decrypting parent package.moc files, which are also
+ * counted in FILE_READ and DECRYPT.
+ */
+enum mlle_stats_phase {
+    MLLE_STATS_PHASE_FILE_READ,
+    MLLE_STATS_PHASE_DEMASK,
+    MLLE_STATS_PHASE_DECRYPT,
+    MLLE_STATS_PHASE_FRAMING,
+    MLLE_STATS_PHASE_TLS_WRITE,
+    MLLE_STATS_PHASE_LICENSE,
+
+    /* This value MUST be the last in the enum. */
+    MLLE_STATS_PHASE_SIZE
+};
+
+enum mlle_stats_counter {
+    MLLE_STATS_BYTES_RECEIVED,
+    MLLE_STATS_BYTES_SENT,
+    MLLE_STATS_FILE_BYTES_READ,
+    MLLE_STATS_FILES_SERVED,
+    MLLE_STATS_FILES_DECRYPTED,
+    MLLE_STATS_FEATURE_CACHE_HITS,
+    MLLE_STATS_FEATURE_CACHE_MISSES,
+
+    /* This value MUST be the last in the enum. */
+    MLLE_STATS_COUNTER_SIZE
+};
+
+/*
+ * One-off steps of starting the LVE, up to validating the Tool's
+ * public key. Each is recorded once, without a histogram.
+ */
+enum mlle_stats_startup {
+    MLLE_STATS_STARTUP_INIT_SSL,
+    MLLE_STATS_STARTUP_KEY_PARSE,
+    MLLE_STATS_STARTUP_X509,
+    MLLE_STATS_STARTUP_ACCEPT,
+    MLLE_STATS_STARTUP_PUBKEY,
+
+    /* This value MUST be the last in the enum. */
+    MLLE_STATS_STARTUP_SIZE
+};
+
+/* Start recording. */
+void mlle_stats_enable(void);
+
+int mlle_stats_enabled(void);
+
+/* Monotonic time in nanoseconds. */
+mlle_stats_ns mlle_stats_now(void);
+
+/* Record the time since start (from mlle_stats_now) for a command. */
+void mlle_stats_command(enum mlle_protocol_command_id command_id,
+                        mlle_stats_ns start);
+
+/* Record the time since start (from mlle_stats_now) for a phase. */
+void mlle_stats_phase(enum mlle_stats_phase phase, mlle_stats_ns start);
+
+/* Record the time since start (from mlle_stats_now) for a startup step. */
+void mlle_stats_startup(enum mlle_stats_startup step, mlle_stats_ns start);
+
+void mlle_stats_count(enum mlle_stats_counter counter,
+                      unsigned long long amount);
+
+/*
+ * Format the counters as lines of "<key>=<value>" into buffer, like
+ * snprintf: returns the length of the full text, even if size was too
+ * small (or buffer NULL) to hold it. Keys are the counter names, plus
+ * <phase>_count, <phase>_total_ns, <phase>_p50_ns and <phase>_p99_ns for
+ * each phase, startup_<step>_ns for each startup step and
+ * cmd_<COMMAND>_count and cmd_<COMMAND>_total_ns for each command seen.
+ */
+size_t mlle_stats_format(char *buffer, size_t size);
+
+/* Write all counters and histograms as one line of JSON. */
+void mlle_stats_write_json(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MLLE_STATS_H_ */
@@ -0,0 +1,171 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+#include <stdlib.h>
+/* mlle_portability.h must be first */
+#include "mlle_portability.h"
+#include "mlle_thread.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+struct mlle_thread {
+    void (*func)(void *);
+    void *arg;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+};
+
+struct mlle_mutex {
+#ifdef _WIN32
+    CRITICAL_SECTION cs;
+#else
+    pthread_mutex_t mutex;
+#endif
+};
+
+#ifdef _WIN32
+static unsigned __stdcall
+mlle_thread_main(void *arg)
+{
+    struct mlle_thread *thread = arg;
+    thread->func(thread->arg);
+    return 0;
+}
+#else
+static void *
+mlle_thread_main(void *arg)
+{
+    struct mlle_thread *thread = arg;
+    thread->func(thread->arg);
+    return NULL;
+}
+#endif
+
+struct mlle_thread *
+mlle_thread_start(void (*func)(void *), void *arg)
+{
+    struct mlle_thread *thread = calloc(1, sizeof(*thread));
+
+    if (thread == NULL) {
+        return NULL;
+    }
+    thread->func = func;
+    thread->arg = arg;
+
+#ifdef _WIN32
+    thread->handle = (HANDLE) _beginthreadex(NULL, 0, mlle_thread_main,
+                                             thread, 0, NULL);
+    if (thread->handle == 0) {
+        free(thread);
+        return NULL;
+    }
+#else
+    if (pthread_create(&thread->handle, NULL, mlle_thread_main, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+#endif
+
+    return thread;
+}
+
+void
+mlle_thread_join(struct mlle_thread *thread)
+{
+    if (thread == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+    free(thread);
+}
+
+int
+mlle_thread_cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int) info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? (int) count : 1;
+#endif
+}
+
+struct mlle_mutex *
+mlle_mutex_new(void)
+{
+    struct mlle_mutex *mutex = calloc(1, sizeof(*mutex));
+
+    if (mutex == NULL) {
+        return NULL;
+    }
+#ifdef _WIN32
+    InitializeCriticalSection(&mutex->cs);
+#else
+    if (pthread_mutex_init(&mutex->mutex, NULL) != 0) {
+        free(mutex);
+        return NULL;
+    }
+#endif
+
+    return mutex;
+}
+
+void
+mlle_mutex_free(struct mlle_mutex *mutex)
+{
+    if (mutex == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    DeleteCriticalSection(&mutex->cs);
+#else
+    pthread_mutex_destroy(&mutex->mutex);
+#endif
+    free(mutex);
+}
+
+void
+mlle_mutex_lock(struct mlle_mutex *mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(&mutex->cs);
+#else
+    pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+void
+mlle_mutex_unlock(struct mlle_mutex *mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(&mutex->cs);
+#else
+    pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
@@ -0,0 +1,69 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+#ifndef MLLE_THREAD_H_
+#define MLLE_THREAD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Minimal portable threads: POSIX threads, or Win32 threads on Windows.
+ */
+struct mlle_thread;
+struct mlle_mutex;
+
+/************************************************************
+ * Start a thread running func(arg).
+ *
+ * Returns:
+ *      the thread, or NULL if it could not be started.
+ ***********************************************************/
+struct mlle_thread *
+mlle_thread_start(void (*func)(void *), void *arg);
+
+/************************************************************
+ * Wait for a thread to finish and release it.
+ ***********************************************************/
+void
+mlle_thread_join(struct mlle_thread *thread);
+
+/************************************************************
+ * Get the number of processors that are online.
+ *
+ * Returns:
+ *      the number of processors, at least 1.
+ ***********************************************************/
+int
+mlle_thread_cpu_count(void);
+
+/************************************************************
+ * Create a mutex. Returns NULL if out of memory.
+ ***********************************************************/
+struct mlle_mutex *
+mlle_mutex_new(void);
+
+void
+mlle_mutex_free(struct mlle_mutex *mutex);
+
+void
+mlle_mutex_lock(struct mlle_mutex *mutex);
+
+void
+mlle_mutex_unlock(struct mlle_mutex *mutex);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MLLE_THREAD_H_ */
@@ -0,0 +1,165 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+
+/* mlle_portability.h must be first */
+#include "mlle_portability.h"
+#include "mlle_stats.h"
+#include "mlle_thread.h"
+#include "mlle_trace.h"
+
+#ifdef _MSC_VER
+#define MLLE_THREAD_LOCAL __declspec(thread)
+#else
+#define MLLE_THREAD_LOCAL __thread
+#endif
+
+struct mlle_trace_ring {
+    struct mlle_trace_ring *next;
+    unsigned int thread;
+    /* Number of events ever written; only the owning thread writes. */
+    unsigned long long written;
+    struct mlle_trace_event events[MLLE_TRACE_RING_EVENTS];
+};
+
+static int trace_enabled = 0;
+/* Protects rings and thread_count when a thread records its first event. */
+static struct mlle_mutex *rings_lock = NULL;
+static struct mlle_trace_ring *rings = NULL;
+static unsigned int thread_count = 0;
+static MLLE_THREAD_LOCAL struct mlle_trace_ring *thread_ring = NULL;
+/* Set when a ring could not be allocated, so we don't try again. */
+static MLLE_THREAD_LOCAL int thread_ring_failed = 0;
+
+static const char *event_names[MLLE_TRACE_EVENT_ID_SIZE] = {
+    "demask", "demask_cached", "demask_parent", "store_keymask",
+    "mask_key", "decrypt_begin", "decrypt_end", "file_request",
+    "file_read", "file_sent", "file_error", "ssl_write", "ssl_read",
+    "key_unmasked"
+};
+
+void mlle_trace_enable(void)
+{
+    if (rings_lock == NULL) {
+        rings_lock = mlle_mutex_new();
+    }
+    trace_enabled = rings_lock != NULL;
+}
+
+int mlle_trace_enabled(void)
+{
+    return trace_enabled;
+}
+
+static struct mlle_trace_ring *get_thread_ring(void)
+{
+    struct mlle_trace_ring *ring = NULL;
+
+    if (thread_ring != NULL || thread_ring_failed) {
+        return thread_ring;
+    }
+
+    ring = calloc(1, sizeof(*ring));
+    if (ring == NULL) {
+        thread_ring_failed = 1;
+        return NULL;
+    }
+    mlle_mutex_lock(rings_lock);
+    ring->thread = thread_count++;
+    ring->next = rings;
+    rings = ring;
+    mlle_mutex_unlock(rings_lock);
+
+    thread_ring = ring;
+    return ring;
+}
+
+void mlle_trace(enum mlle_trace_event_id id,
+                long long arg0, long long arg1, long long arg2)
+{
+    struct mlle_trace_ring *ring = NULL;
+    struct mlle_trace_event *event = NULL;
+
+    if (!trace_enabled) {
+        return;
+    }
+    ring = get_thread_ring();
+    if (ring == NULL) {
+        return;
+    }
+
+    event = &ring->events[ring->written % MLLE_TRACE_RING_EVENTS];
+    event->timestamp = mlle_stats_now();
+    event->id = (unsigned int) id;
+    event->thread = ring->thread;
+    event->args[0] = arg0;
+    event->args[1] = arg1;
+    event->args[2] = arg2;
+    ring->written++;
+}
+
+long long mlle_trace_hash(const char *string)
+{
+    unsigned int hash = 2166136261u;
+
+    if (string == NULL) {
+        return 0;
+    }
+    while (*string) {
+        hash ^= (unsigned char) *string++;
+        hash *= 16777619u;
+    }
+    return (long long) hash;
+}
+
+const char *mlle_trace_event_name(unsigned int id)
+{
+    if (id >= MLLE_TRACE_EVENT_ID_SIZE) {
+        return "unknown";
+    }
+    return event_names[id];
+}
+
+void mlle_trace_dump(FILE *out)
+{
+    struct mlle_trace_ring *ring = NULL;
+    unsigned long long count = 0;
+
+    if (out == NULL || !trace_enabled) {
+        return;
+    }
+
+    mlle_mutex_lock(rings_lock);
+    for (ring = rings; ring != NULL; ring = ring->next) {
+        count += ring->written < MLLE_TRACE_RING_EVENTS
+            ? ring->written : MLLE_TRACE_RING_EVENTS;
+    }
+    fprintf(out, "\n%s %d %u %llu\n", MLLE_TRACE_MARKER, MLLE_TRACE_VERSION,
+            (unsigned int) sizeof(struct mlle_trace_event), count);
+    for (ring = rings; ring != NULL; ring = ring->next) {
+        size_t oldest = (size_t) (ring->written % MLLE_TRACE_RING_EVENTS);
+
+        if (ring->written > MLLE_TRACE_RING_EVENTS) {
+            fwrite(&ring->events[oldest], sizeof(struct mlle_trace_event),
+                   MLLE_TRACE_RING_EVENTS - oldest, out);
+            fwrite(&ring->events[0], sizeof(struct mlle_trace_event),
+                   oldest, out);
+        } else {
+            fwrite(&ring->events[0], sizeof(struct mlle_trace_event),
+                   (size_t) ring->written, out);
+        }
+    }
+    mlle_mutex_unlock(rings_lock);
+    fflush(out);
+}
@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+#ifndef MLLE_TRACE_H_
+#define MLLE_TRACE_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Binary event trace for hot paths, where fprintf to mlle_log would
+ * distort timing.
+ *
+ * Each thread records into its own ring buffer of MLLE_TRACE_RING_EVENTS
+ * events, without locks; when a ring is full the oldest events are
+ * overwritten. Events carry only integers: never key material, and paths
+ * only as their length and mlle_trace_hash().
+ *
+ * mlle_trace_dump() appends the rings to a log file behind a text marker
+ * line; the decode_trace program turns them back into text.
+ */
+
+#ifndef MLLE_TRACE_RING_EVENTS
+#define MLLE_TRACE_RING_EVENTS (16384)
+#endif
+
+#define MLLE_TRACE_MARKER "MLLE_TRACE"
+#define MLLE_TRACE_VERSION (1)
+#define MLLE_TRACE_ARGS (3)
+
+enum mlle_trace_event_id {
+    MLLE_TRACE_DEMASK,              /* path hash, path length */
+    MLLE_TRACE_DEMASK_CACHED,       /* path hash */
+    MLLE_TRACE_DEMASK_PARENT,       /* path hash of parent package.moc, file size */
+    MLLE_TRACE_STORE_KEYMASK,       /* path hash */
+    MLLE_TRACE_MASK_KEY,            /* path hash, 0 got key / 1 new mask / 2 parent mask / 3 applied */
+    MLLE_TRACE_DECRYPT_BEGIN,       /* path hash, input length */
+    MLLE_TRACE_DECRYPT_END,         /* path hash, result */
+    MLLE_TRACE_FILE_REQUEST,        /* path hash, path length */
+    MLLE_TRACE_FILE_READ,           /* path hash, file size */
+    MLLE_TRACE_FILE_SENT,           /* path hash, bytes */
+    MLLE_TRACE_FILE_ERROR,          /* path hash, protocol error code */
+    MLLE_TRACE_SSL_WRITE,           /* requested length, result */
+    MLLE_TRACE_SSL_READ,            /* result, SSL error code */
+    MLLE_TRACE_KEY_UNMASKED,        /* no random bytes to mask the key of a context with */
+
+    /* This value MUST be the last in the enum. */
+    MLLE_TRACE_EVENT_ID_SIZE
+};
+
+struct mlle_trace_event {
+    unsigned long long timestamp;   /* ns, see mlle_stats_now() */
+    unsigned int id;                /* enum mlle_trace_event_id */
+    unsigned int thread;            /* order in which threads first recorded */
+    long long args[MLLE_TRACE_ARGS];
+};
+
+/* Start recording. Call before any other threads are started. */
+void mlle_trace_enable(void);
+
+int mlle_trace_enabled(void);
+
+/* Record an event in the calling thread's ring. */
+void mlle_trace(enum mlle_trace_event_id id,
+                long long arg0, long long arg1, long long arg2);
+
+/* FNV-1a hash of a string, to identify paths without recording them. */
+long long mlle_trace_hash(const char *string);
+
+const char *mlle_trace_event_name(unsigned int id);
+
+/*
+ * Write all recorded events, oldest first per thread, as the line
+ * "MLLE_TRACE <version> <event size> <count>" followed by count raw
+ * struct mlle_trace_event. Other threads must not be recording.
+ */
+void mlle_trace_dump(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MLLE_TRACE_H_ */
@@ -10,8 +10,12 @@ extern "C" {
 #endif /* __cplusplus */
 
 #include <uthash.h>
+#include <openssl/opensslv.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
 
 #include "random_key_file.h"
+#include "mlle_cr_key.h"
 
 #define PACKAGE_MO_STRLEN 10
 #define PACKAGE_MOC_STRLEN 11
@@ -19,13 +23,38 @@ extern "C" {
 typedef struct mlle_key_mask_map {
     char* relpath;             /* relative path to directory acts as hash key */    
     UT_hash_handle hh;         /* makes this structure hashable */
-    char key_mask[MLLE_CR_KEY_LEN];
+    unsigned char* key_mask;   /* MLLE_CR_KEY_LEN bytes from mlle_cr_key_mask_alloc */
     char buffer[2];
 } mlle_key_mask_map;
 
+/*
+ * Cipher and MAC objects kept between mlle_cr_decrypt calls, so that the
+ * algorithms are looked up and the contexts allocated once per library
+ * instead of once per file. Created on first use, see mlle_cr_session_init.
+ */
+struct mlle_cr_session {
+    EVP_CIPHER_CTX *cipher_ctx;
+    EVP_CIPHER_CTX *gcm_ctx;    /* for MLLE_CR_FORMAT_GCM */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_CIPHER *cipher;         /* fetched once */
+    EVP_CIPHER *gcm_cipher;     /* fetched once */
+    EVP_MAC *mac;               /* fetched once */
+    EVP_MAC_CTX *mac_ctx;
+#else
+    HMAC_CTX *mac_ctx;
+#endif
+    unsigned long key_serial;   /* changed whenever the contexts above may get another key */
+};
+
 struct mlle_cr_context {
     char no_mask[MLLE_CR_KEY_LEN]; /* empty mask used for top-level package.moc */
     struct mlle_key_mask_map* keymask_map; /* makes this structure hashable */
+    struct mlle_mutex* mask_mutex; /* held while mlle_cr_encrypt uses keymask_map */
+    struct mlle_cr_session session;
+    struct mlle_cr_key* key;     /* materialised once, see mlle_cr_key.h */
+    int format;                  /* format written by mlle_cr_encrypt, 0 for the default */
+    int decrypt_threads;         /* threads to decrypt chunked data with, see mlle_cr_create */
+    size_t parallel_min_len;     /* decrypt chunked data of at least this length in parallel */
     char basedir[1];             /*  basedir where all encrypted files are stored.  */
     /*  Relpath used in keymap are relative to this directory. */
 };
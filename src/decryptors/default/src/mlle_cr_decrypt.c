@@ -23,49 +23,208 @@
 #include <string.h>
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
 #include "mlle_cr_crypt.h"
+#include "mlle_cr_encrypt.h"
 #include "random_key_file.h"
 #include "mlle_cr_decrypt.h"
 #include "mlle_cr_context.h"
 #include "mlle_portability.h"
 #include "mlle_io.h"
 #include "mlle_error.h"
+#include "mlle_stats.h"
+#include "mlle_thread.h"
+#include "mlle_trace.h"
+
+/*
+ * Decrypt and MAC this much at a time, so that each chunk of plaintext is
+ * still in the L2 cache when it is MACed. Must be a multiple of the block size.
+ */
+#define DECRYPT_CHUNK_LEN (64 * 1024)
 
+/*
+ * Size of the buffer that mlle_cr_verify decrypts to, a piece at a time.
+ * Must be a multiple of the block size.
+ */
+#define VERIFY_SCRATCH_LEN (16 * 1024)
+
+/*
+ * Chunked data (format 3) of at least this length is decrypted by several threads, by default
+ * one per processor but at most DECRYPT_THREADS_MAX. Set by the environment variables
+ * SEMLA_DECRYPT_PARALLEL_MIN (bytes) and SEMLA_DECRYPT_THREADS (1 turns it off).
+ */
+#define DECRYPT_PARALLEL_MIN_LEN (8 * 1024 * 1024)
+#define DECRYPT_THREADS_MAX (16)
+
+#if MLLE_CR_CHUNK_HEADER_LEN != MLLE_CR_CHUNKED_HEADER_LENGTH
+#error "MLLE_CR_CHUNK_HEADER_LEN must match the chunked format"
+#endif
 
 mlle_cr_context* mlle_cr_create(const char* basedir) {
     size_t len = strlen(basedir);
+    const char *threads = getenv("SEMLA_DECRYPT_THREADS");
+    const char *parallel_min = getenv("SEMLA_DECRYPT_PARALLEL_MIN");
     mlle_cr_context * c = calloc(1, sizeof(mlle_cr_context) + len);
     if (NULL == c) return NULL;
     memcpy(c->basedir, basedir, len);
+    c->key = mlle_cr_key_new();
+    c->mask_mutex = mlle_mutex_new();
+    if (c->key == NULL || c->mask_mutex == NULL) {
+        mlle_cr_key_free(c->key);
+        mlle_mutex_free(c->mask_mutex);
+        free(c);
+        return NULL;
+    }
+
+    c->decrypt_threads = threads ? atoi(threads) : 0;
+    if (c->decrypt_threads <= 0) {
+        c->decrypt_threads = mlle_thread_cpu_count();
+        if (c->decrypt_threads > DECRYPT_THREADS_MAX)
+            c->decrypt_threads = DECRYPT_THREADS_MAX;
+    }
+    c->parallel_min_len = parallel_min ? (size_t) strtoul(parallel_min, NULL, 10) : DECRYPT_PARALLEL_MIN_LEN;
     return c;
 }
 
-void mlle_cr_free(mlle_cr_context* context) {
-    free(context);
+static void mlle_cr_session_free(struct mlle_cr_session* session) {
+    unsigned long key_serial = session->key_serial;
+
+    EVP_CIPHER_CTX_free(session->cipher_ctx);
+    EVP_CIPHER_CTX_free(session->gcm_ctx);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_CIPHER_free(session->gcm_cipher);
+    EVP_MAC_CTX_free(session->mac_ctx);
+    EVP_MAC_free(session->mac);
+    EVP_CIPHER_free(session->cipher);
+#else
+    HMAC_CTX_free(session->mac_ctx);
+#endif
+    memset(session, 0, sizeof(*session));
+    /* A session that is set up again has no key. */
+    session->key_serial = key_serial + 1;
 }
 
-#if defined(DEBUG) || defined(_DEBUG)
-void mlle_debug_log_key(const unsigned char* key) {
-    int i;
-    char buf[MLLE_CR_KEY_LEN * 3 + 4];
-    char* ptr = buf;
+/*
+* Set up the cipher and MAC objects of a session, unless already done.
+* The cipher context is initialized with the cipher but no key, so that each file only needs to set key and IV.
+* Returns 1 on success and 0 on failure.
+*/
+static int mlle_cr_session_init(struct mlle_cr_session* session) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    OSSL_PARAM params[2];
+#endif
 
-    for ( i = 0; i < MLLE_CR_KEY_LEN; i++)
-    {
-        const char* format = (i > 0)? ":%02X" :"%02X";
-        unsigned int code = key[i];
-        sprintf(ptr, format, code);
-        ptr += (i == 0) ? 2 : 3;
-        *ptr = '\0';
-    }
+    if (session->cipher_ctx != NULL)
+        return 1;
 
-    fprintf(mlle_log, "key: %s\n", buf);
-    buf[0] = 0;
+    session->cipher_ctx = EVP_CIPHER_CTX_new();
+    if (session->cipher_ctx == NULL)
+        return 0;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    /* Given EVP_aes_256_cbc() etc., OpenSSL 3 looks up the implementation again on every init. */
+    session->cipher = EVP_CIPHER_fetch(NULL, EVP_CIPHER_get0_name(MLLE_CR_CIPHER), NULL);
+    session->mac = EVP_MAC_fetch(NULL, OSSL_MAC_NAME_HMAC, NULL);
+    if (session->cipher == NULL || session->mac == NULL)
+        goto error;
+    session->mac_ctx = EVP_MAC_CTX_new(session->mac);
+    if (session->mac_ctx == NULL)
+        goto error;
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                                 (char*) EVP_MD_get0_name(MLLE_CR_HASH), 0);
+    params[1] = OSSL_PARAM_construct_end();
+    if (!EVP_MAC_CTX_set_params(session->mac_ctx, params))
+        goto error;
+    if (!EVP_DecryptInit_ex(session->cipher_ctx, session->cipher, NULL, NULL, NULL))
+        goto error;
+#else
+    session->mac_ctx = HMAC_CTX_new();
+    if (session->mac_ctx == NULL)
+        goto error;
+    if (!EVP_DecryptInit_ex(session->cipher_ctx, MLLE_CR_CIPHER, NULL, NULL, NULL))
+        goto error;
+#endif
+    return 1;
+
+error:
+    mlle_cr_session_free(session);
+    return 0;
 }
+
+/*
+* Set up the AES-256-GCM cipher context of a session, unless already done.
+* Returns 1 on success and 0 on failure.
+*/
+static int mlle_cr_session_init_gcm(struct mlle_cr_session* session) {
+    if (session->gcm_ctx != NULL)
+        return 1;
+
+    session->gcm_ctx = EVP_CIPHER_CTX_new();
+    if (session->gcm_ctx == NULL)
+        return 0;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    session->gcm_cipher = EVP_CIPHER_fetch(NULL, EVP_CIPHER_get0_name(MLLE_CR_GCM_CIPHER), NULL);
+    if (session->gcm_cipher == NULL
+        || !EVP_DecryptInit_ex(session->gcm_ctx, session->gcm_cipher, NULL, NULL, NULL))
+        goto error;
 #else
-void mlle_debug_log_key(const unsigned char* key) { }
+    if (!EVP_DecryptInit_ex(session->gcm_ctx, MLLE_CR_GCM_CIPHER, NULL, NULL, NULL))
+        goto error;
 #endif
+    return 1;
 
+error:
+    EVP_CIPHER_CTX_free(session->gcm_ctx);
+    session->gcm_ctx = NULL;
+    return 0;
+}
+
+/* Start a MAC computation with a new key, or with the previous one if key is NULL. */
+static int mlle_cr_session_mac_init(struct mlle_cr_session* session, const unsigned char* key) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_MAC_init(session->mac_ctx, key, key ? MLLE_CR_KEY_LEN : 0, NULL);
+#else
+    return HMAC_Init_ex(session->mac_ctx, key, key ? MLLE_CR_KEY_LEN : 0, key ? MLLE_CR_HASH : NULL, NULL);
+#endif
+}
+
+static int mlle_cr_session_mac_update(struct mlle_cr_session* session, const unsigned char* data, size_t len) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_MAC_update(session->mac_ctx, data, len);
+#else
+    return HMAC_Update(session->mac_ctx, data, len);
+#endif
+}
+
+/* Finish the MAC computation, mac must hold EVP_MAX_MD_SIZE bytes. */
+static int mlle_cr_session_mac_final(struct mlle_cr_session* session, unsigned char* mac) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    size_t mac_len = 0;
+    return EVP_MAC_final(session->mac_ctx, mac, &mac_len, EVP_MAX_MD_SIZE);
+#else
+    unsigned int mac_len = 0;
+    return HMAC_Final(session->mac_ctx, mac, &mac_len);
+#endif
+}
+
+void mlle_cr_free(mlle_cr_context* context) {
+    struct mlle_key_mask_map* map_item = NULL;
+    struct mlle_key_mask_map* tmp = NULL;
+
+    if (context) {
+        mlle_cr_session_free(&context->session);
+        /* The key masks themselves are wiped and freed with the key. */
+        HASH_ITER(hh, context->keymask_map, map_item, tmp) {
+            HASH_DEL(context->keymask_map, map_item);
+            free(map_item);
+        }
+        mlle_cr_key_free(context->key);
+        mlle_mutex_free(context->mask_mutex);
+    }
+    free(context);
+}
 
 int mlle_demask_key(mlle_cr_context* context, const char* rel_file_path, unsigned char* key) {
     char path[MLLE_LONG_FILE_NAME_MAX];
@@ -82,10 +241,8 @@ int mlle_demask_key(mlle_cr_context* context, const char* rel_file_path, unsigne
     int ret = 0;
     struct mlle_error * error = 0;
     int is_package_mo_file = 0;
-    if (mlle_log) {
-        fprintf(mlle_log, "mlle_demask_key: %s\n", rel_file_path);
-        mlle_debug_log_key(key);
-    }
+    mlle_trace(MLLE_TRACE_DEMASK, mlle_trace_hash(rel_file_path),
+               (long long) strlen(rel_file_path), 0);
 
     while (rel_file_path[i] && (i < MLLE_LONG_FILE_NAME_MAX)) {
         ch = rel_file_path[i];
@@ -132,10 +289,7 @@ int mlle_demask_key(mlle_cr_context* context, const char* rel_file_path, unsigne
        for (i = 0; i < MLLE_CR_KEY_LEN; ++i) {
             key[i] = key[i] ^ map_item->key_mask[i];
        }
-       if (mlle_log) {
-           fprintf(mlle_log, "mlle_demask_key: applied mask for %s\n", rel_file_path);
-           mlle_debug_log_key(key);
-       }
+       mlle_trace(MLLE_TRACE_DEMASK_CACHED, mlle_trace_hash(rel_file_path), 0, 0);
 
        return 0;
     }  
@@ -153,18 +307,15 @@ int mlle_demask_key(mlle_cr_context* context, const char* rel_file_path, unsigne
         ret = mlle_demask_key(context, path, key);
     }
     else {
-        out_buffer = malloc(file_size);
-        if (file_buffer && out_buffer) {
-            int ret_code = mlle_cr_decrypt(context, path, file_buffer, file_size, out_buffer);
+        if (file_buffer) {
+            int ret_code = mlle_cr_decrypt_inplace(context, path, file_buffer, file_size, &out_buffer);
             if (ret_code > 0) {
                 /* key mask is now in the hash but it's also the tail in the outbuffer */
                 for (i = 0; i < MLLE_CR_KEY_LEN; ++i) {
                     key[i] = key[i] ^ out_buffer[ret_code + i];
                 }
-                if (mlle_log) {
-                    fprintf(mlle_log, "mlle_demask_key: applied mask for %s\n", rel_file_path);
-                    mlle_debug_log_key(key);
-                }
+                mlle_trace(MLLE_TRACE_DEMASK_PARENT, mlle_trace_hash(path),
+                           (long long) file_size, 0);
 
             }
             else {
@@ -180,7 +331,6 @@ int mlle_demask_key(mlle_cr_context* context, const char* rel_file_path, unsigne
 
   cleanup:
     free(file_buffer);
-    free(out_buffer);
     mlle_error_free(&error);
     return ret;
 }
@@ -211,6 +361,11 @@ int mlle_store_keymask(mlle_cr_context* context, const char* rel_file_path, cons
     if (map_item == NULL) {
         return -1;
     }
+    map_item->key_mask = mlle_cr_key_mask_alloc(context->key);
+    if (map_item->key_mask == NULL) {
+        free(map_item);
+        return -1;
+    }
     map_item->relpath = map_item->buffer;
     memcpy(map_item->relpath, relpath, rel_path_len);
     memcpy(map_item->key_mask, key_mask, MLLE_CR_KEY_LEN);
@@ -218,125 +373,730 @@ int mlle_store_keymask(mlle_cr_context* context, const char* rel_file_path, cons
     HASH_ADD_KEYPTR(hh, key_mask_map, map_item->relpath, rel_path_len, map_item);  
     context->keymask_map = key_mask_map;
 
-    if (mlle_log) {
-        fprintf(mlle_log, "mlle_store_keymask: stored key_mask for %s \n", rel_file_path);
-        mlle_debug_log_key(key_mask);
-    }
+    mlle_trace(MLLE_TRACE_STORE_KEYMASK, mlle_trace_hash(rel_file_path), 0, 0);
 
     return 0;
 }
 
 
 /*
-* Decrypt the data pointed to by in to out, where in_len is the length of the data pointed to by in.
-*  - key_cache - contains the table of key masks to be used in different directories.
-*  - rel_file_path - relative path to the file within library used for finding the needed key_mask
-*
-* The data pointed to by in is assumed to consist of IV, encrypted mask + data and HMAC, in that order.
-* The buffer pointed to by out must be large enough to hold the masc + the decrypted data, which is always shorter than in_len.
-* The in and out buffers may not be the same.
-*
+* Get the format of encrypted data: MLLE_CR_FORMAT_CBC_HMAC if it has no header, else the format
+* number in the header. Legacy data starts with a random IV, which matches MLLE_CR_MAGIC with
+* probability 2^-64.
+*/
+static int mlle_cr_format(const unsigned char* in, size_t in_len) {
+    if (in_len < MLLE_CR_HEADER_LENGTH || memcmp(in, MLLE_CR_MAGIC, MLLE_CR_MAGIC_LENGTH) != 0)
+        return MLLE_CR_FORMAT_CBC_HMAC;
+    return in[MLLE_CR_MAGIC_LENGTH];
+}
+
+/* Offset of the encrypted data in the given format, -1 for unknown formats. */
+static int mlle_cr_data_offset(int format) {
+    switch (format) {
+    case MLLE_CR_FORMAT_CBC_HMAC:
+        return EVP_CIPHER_iv_length(MLLE_CR_CIPHER);
+    case MLLE_CR_FORMAT_GCM:
+        return MLLE_CR_HEADER_LENGTH + MLLE_CR_GCM_NONCE_LENGTH;
+    case MLLE_CR_FORMAT_GCM_CHUNKED:
+        return MLLE_CR_CHUNKED_HEADER_LENGTH;
+    default:
+        return -1;
+    }
+}
+
+/*
+* Decrypt format 1: IV, AES-256-CBC encrypted data and HMAC-SHA256 of IV + plaintext.
+* If key is NULL, the key last used with the session is used again without setting it up anew.
+* If discard is set, out is a buffer of VERIFY_SCRATCH_LEN bytes that each piece is decrypted to in turn.
 * Returns the length of the decrypted data, or -1 on an error.
 */
-int mlle_cr_decrypt(
+static int mlle_cr_decrypt_cbc(struct mlle_cr_session* session, const unsigned char* key,
+                               unsigned char* in, size_t in_len, unsigned char* out, int discard)
+{
+    unsigned char *iv_in = in;
+    unsigned char *enc_in;
+    unsigned char *mac_in;
+    unsigned char *last = NULL;
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    int iv_len = EVP_CIPHER_iv_length(MLLE_CR_CIPHER);
+    int block_len = EVP_CIPHER_block_size(MLLE_CR_CIPHER);
+    size_t mac_len = (size_t) EVP_MD_size(MLLE_CR_HASH);
+    int enc_len = 0;
+    int dec_len = 0;
+    int pos = 0;
+    int chunk_len = 0;
+    int max_chunk_len = discard ? VERIFY_SCRATCH_LEN : DECRYPT_CHUNK_LEN;
+    int pad = 0;
+    int i = 0;
+
+    /* Split incoming data. */
+    if (in_len < iv_len + mac_len)
+        return -1;
+    enc_in = iv_in + iv_len;
+    mac_in = iv_in + in_len - mac_len;
+    enc_len = (int)(in_len - iv_len - mac_len);
+    if (enc_len < block_len || enc_len % block_len != 0)
+        return -1;
+
+    if (!mlle_cr_session_init(session))
+        return -1;
+    /* The cipher is already set, only key and IV change between files. */
+    if (!EVP_DecryptInit_ex(session->cipher_ctx, NULL, NULL, key, iv_in))
+        return -1;
+    /* The padding is checked below instead, so that the output never lags
+       behind the input and each chunk can be MACed as soon as it is decrypted. */
+    EVP_CIPHER_CTX_set_padding(session->cipher_ctx, 0);
+    if (!mlle_cr_session_mac_init(session, key))
+        return -1;
+    if (!mlle_cr_session_mac_update(session, iv_in, iv_len))
+        return -1;
+
+    /* Decrypt data and calculate HMAC a chunk at a time. The last block
+       holds the padding, which is not part of the HMAC. */
+    for (pos = 0; pos < enc_len; pos += chunk_len) {
+        chunk_len = enc_len - pos < max_chunk_len ? enc_len - pos : max_chunk_len;
+        last = discard ? out : out + pos;
+        if (!EVP_DecryptUpdate(session->cipher_ctx, last, &dec_len, enc_in + pos, chunk_len))
+            return -1;
+        if (dec_len != chunk_len)
+            return -1;
+        if (!mlle_cr_session_mac_update(session, last,
+                pos + chunk_len == enc_len ? chunk_len - block_len : chunk_len))
+            return -1;
+    }
+    /* Let last point to the end of the plaintext. */
+    last += chunk_len;
+    if (!EVP_DecryptFinal_ex(session->cipher_ctx, last, &dec_len))
+        return -1;
+
+    /* Check and strip the PKCS#7 padding. */
+    pad = last[-1];
+    if (pad < 1 || pad > block_len)
+        return -1;
+    for (i = 2; i <= pad; i++) {
+        if (last[-i] != pad)
+            return -1;
+    }
+
+    /* Finish and check HMAC. */
+    if (!mlle_cr_session_mac_update(session, last - block_len, block_len - pad))
+        return -1;
+    if (!mlle_cr_session_mac_final(session, mac))
+        return -1;
+    if (memcmp(mac, mac_in, mac_len))
+        return -1;
+
+    return enc_len - pad;
+}
+
+/*
+* Decrypt the len bytes at in with ctx, to out or, if discard is set, a piece at a time
+* to the VERIFY_SCRATCH_LEN bytes at out. Returns 1 on success and 0 on failure.
+*/
+static int mlle_cr_decrypt_update(EVP_CIPHER_CTX* ctx, const unsigned char* in, int len,
+                                  unsigned char* out, int discard)
+{
+    int pos = 0;
+    int n = 0;
+    int dec_len = 0;
+
+    if (!discard)
+        return EVP_DecryptUpdate(ctx, out, &dec_len, in, len) && dec_len == len;
+    for (pos = 0; pos < len; pos += n) {
+        n = len - pos < VERIFY_SCRATCH_LEN ? len - pos : VERIFY_SCRATCH_LEN;
+        if (!EVP_DecryptUpdate(ctx, out, &dec_len, in + pos, n) || dec_len != n)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+* Decrypt format 2: header, nonce, AES-256-GCM encrypted data and tag, with the header as AAD.
+* If key is NULL, the key last used with the session is used again without setting it up anew.
+* If discard is set, out is a buffer of VERIFY_SCRATCH_LEN bytes that each piece is decrypted to in turn.
+* Returns the length of the decrypted data, or -1 on an error.
+*/
+static int mlle_cr_decrypt_gcm(struct mlle_cr_session* session, const unsigned char* key,
+                               unsigned char* in, size_t in_len, unsigned char* out, int discard)
+{
+    unsigned char *nonce = in + MLLE_CR_HEADER_LENGTH;
+    unsigned char *enc_in = nonce + MLLE_CR_GCM_NONCE_LENGTH;
+    unsigned char tag[MLLE_CR_GCM_TAG_LENGTH];
+    int enc_len = 0;
+    int len = 0;
+
+    if (in_len < MLLE_CR_HEADER_LENGTH + MLLE_CR_GCM_NONCE_LENGTH + MLLE_CR_GCM_TAG_LENGTH)
+        return -1;
+    enc_len = (int) (in_len - MLLE_CR_HEADER_LENGTH - MLLE_CR_GCM_NONCE_LENGTH - MLLE_CR_GCM_TAG_LENGTH);
+    memcpy(tag, enc_in + enc_len, MLLE_CR_GCM_TAG_LENGTH);
+
+    if (!mlle_cr_session_init_gcm(session))
+        return -1;
+    if (!EVP_DecryptInit_ex(session->gcm_ctx, NULL, NULL, key, nonce))
+        return -1;
+    if (!EVP_DecryptUpdate(session->gcm_ctx, NULL, &len, in, MLLE_CR_HEADER_LENGTH))
+        return -1;
+    if (!mlle_cr_decrypt_update(session->gcm_ctx, enc_in, enc_len, out, discard))
+        return -1;
+    if (!EVP_CIPHER_CTX_ctrl(session->gcm_ctx, EVP_CTRL_AEAD_SET_TAG, MLLE_CR_GCM_TAG_LENGTH, tag))
+        return -1;
+    /* Fails if the tag does not match. GCM has no output here. */
+    if (!EVP_DecryptFinal_ex(session->gcm_ctx, out, &len))
+        return -1;
+
+    return enc_len;
+}
+
+/*
+* Check the header of format 3 data of length in_len, and get the plaintext length of full chunks
+* and the number of chunks. Returns 1 on success and 0 if the header or length is invalid.
+*/
+static int mlle_cr_chunked_layout(const unsigned char* header, size_t in_len,
+                                  size_t* chunk_len, size_t* chunk_count)
+{
+    const unsigned char *p = header + MLLE_CR_HEADER_LENGTH;
+    size_t stride;
+    size_t rest;
+
+    if (in_len < MLLE_CR_CHUNKED_HEADER_LENGTH + MLLE_CR_GCM_TAG_LENGTH)
+        return 0;
+    if (header[MLLE_CR_MAGIC_LENGTH] != MLLE_CR_FORMAT_GCM_CHUNKED || header[MLLE_CR_MAGIC_LENGTH + 1]
+        || header[MLLE_CR_MAGIC_LENGTH + 2] || header[MLLE_CR_MAGIC_LENGTH + 3])
+        return 0;
+    *chunk_len = (size_t) p[0] | (size_t) p[1] << 8 | (size_t) p[2] << 16 | (size_t) p[3] << 24;
+    if (*chunk_len == 0 || *chunk_len > MLLE_CR_CHUNK_LENGTH_MAX)
+        return 0;
+
+    /* All chunks but the last are full, and the last one holds at least the tag. */
+    stride = *chunk_len + MLLE_CR_GCM_TAG_LENGTH;
+    rest = in_len - MLLE_CR_CHUNKED_HEADER_LENGTH;
+    *chunk_count = rest / stride;
+    if (rest % stride >= MLLE_CR_GCM_TAG_LENGTH)
+        (*chunk_count)++;
+    else if (rest % stride != 0)
+        return 0;
+    if (*chunk_count > 0xffffffffUL)
+        return 0;
+    return 1;
+}
+
+/*
+* Decrypt and verify chunk number index of format 3 data, given the header of the data, the chunk
+* and its length including the tag. The output may overlap the chunk, as done when decrypting in place.
+* If key is NULL, the key already set in ctx is kept.
+* If discard is set, out is a buffer of VERIFY_SCRATCH_LEN bytes that each piece is decrypted to in turn.
+* Returns the length of the decrypted data, or -1 on an error.
+*/
+static int mlle_cr_decrypt_chunk_ctx(EVP_CIPHER_CTX* ctx, const unsigned char* key,
+                                     const unsigned char* header, size_t index, int last,
+                                     const unsigned char* in, size_t in_len, unsigned char* out,
+                                     int discard)
+{
+    unsigned char nonce[MLLE_CR_GCM_NONCE_LENGTH];
+    unsigned char tag[MLLE_CR_GCM_TAG_LENGTH];
+    unsigned char last_flag = last ? 1 : 0;
+    int enc_len = 0;
+    int len = 0;
+
+    if (in_len < MLLE_CR_GCM_TAG_LENGTH)
+        return -1;
+    enc_len = (int) (in_len - MLLE_CR_GCM_TAG_LENGTH);
+    memcpy(tag, in + enc_len, MLLE_CR_GCM_TAG_LENGTH);
+    memcpy(nonce, header + MLLE_CR_HEADER_LENGTH + 4, MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH);
+    nonce[MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH] = (index >> 24) & 0xff;
+    nonce[MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH + 1] = (index >> 16) & 0xff;
+    nonce[MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH + 2] = (index >> 8) & 0xff;
+    nonce[MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH + 3] = index & 0xff;
+
+    /* OpenSSL only allows the output to overlap the input if they are the same. */
+    if (!discard && out != in && out < in + enc_len && in < out + enc_len) {
+        memmove(out, in, enc_len);
+        in = out;
+    }
+
+    if (!EVP_DecryptInit_ex(ctx, NULL, NULL, key, nonce))
+        return -1;
+    if (!EVP_DecryptUpdate(ctx, NULL, &len, header, MLLE_CR_CHUNKED_HEADER_LENGTH))
+        return -1;
+    if (!EVP_DecryptUpdate(ctx, NULL, &len, &last_flag, 1))
+        return -1;
+    if (!mlle_cr_decrypt_update(ctx, in, enc_len, out, discard))
+        return -1;
+    if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, MLLE_CR_GCM_TAG_LENGTH, tag))
+        return -1;
+    /* Fails if the tag does not match. GCM has no output here. */
+    if (!EVP_DecryptFinal_ex(ctx, out, &len))
+        return -1;
+
+    return enc_len;
+}
+
+/*
+* A range of chunks of format 3 data for one thread to decrypt. If in_place is set each chunk
+* is decrypted where it is, otherwise to its place in out.
+*/
+struct mlle_cr_chunk_job {
+    const EVP_CIPHER *cipher;
+    const unsigned char *key;
+    unsigned char *in;
+    size_t in_len;
+    unsigned char *out;
+    int in_place;
+    size_t chunk_len;
+    size_t chunk_count;
+    size_t first;
+    size_t end;
+    int ok;
+};
+
+static void mlle_cr_chunk_job_run(void* arg) {
+    struct mlle_cr_chunk_job *job = arg;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    size_t stride = job->chunk_len + MLLE_CR_GCM_TAG_LENGTH;
+    size_t i = 0;
+    size_t pos = 0;
+    size_t enc_len = 0;
+
+    job->ok = 0;
+    if (ctx == NULL || !EVP_DecryptInit_ex(ctx, job->cipher, NULL, NULL, NULL))
+        goto cleanup;
+    for (i = job->first; i < job->end; i++) {
+        pos = MLLE_CR_CHUNKED_HEADER_LENGTH + i * stride;
+        enc_len = i + 1 == job->chunk_count ? job->in_len - pos : stride;
+        if (mlle_cr_decrypt_chunk_ctx(ctx, i == job->first ? job->key : NULL, job->in, i,
+                                      i + 1 == job->chunk_count, job->in + pos,
+                                      enc_len, job->in_place ? job->in + pos : job->out + i * job->chunk_len, 0)
+            != (int) (enc_len - MLLE_CR_GCM_TAG_LENGTH))
+            goto cleanup;
+    }
+    job->ok = 1;
+
+cleanup:
+    EVP_CIPHER_CTX_free(ctx);
+}
+
+/*
+* Decrypt the chunks of format 3 data with up to threads threads, each with a range of chunks
+* and its own cipher context. The calling thread takes the first range. When decrypting in place,
+* a chunk would overwrite the end of the chunk before it, which may not have been decrypted yet, so
+* the chunks are decrypted where they are and moved together afterwards.
+* Returns the length of the decrypted data, or -1 on an error.
+*/
+static int mlle_cr_decrypt_chunked_parallel(struct mlle_cr_session* session, const unsigned char* key,
+                                            unsigned char* in, size_t in_len, unsigned char* out,
+                                            size_t chunk_len, size_t chunk_count, int threads)
+{
+    struct mlle_cr_chunk_job jobs[DECRYPT_THREADS_MAX];
+    struct mlle_thread *handles[DECRYPT_THREADS_MAX] = { 0 };
+    size_t stride = chunk_len + MLLE_CR_GCM_TAG_LENGTH;
+    int in_place = out < in + in_len && in < out + in_len;
+    size_t out_len = 0;
+    size_t pos = 0;
+    size_t n = 0;
+    size_t i = 0;
+    int ok = 1;
+    int t = 0;
+
+    for (t = 0; t < threads; t++) {
+        jobs[t].cipher =
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            session->gcm_cipher;
+#else
+            MLLE_CR_GCM_CIPHER;
+#endif
+        jobs[t].key = key;
+        jobs[t].in = in;
+        jobs[t].in_len = in_len;
+        jobs[t].out = out;
+        jobs[t].in_place = in_place;
+        jobs[t].chunk_len = chunk_len;
+        jobs[t].chunk_count = chunk_count;
+        jobs[t].first = chunk_count * t / threads;
+        jobs[t].end = chunk_count * (t + 1) / threads;
+        jobs[t].ok = 0;
+    }
+    for (t = 1; t < threads; t++) {
+        handles[t] = mlle_thread_start(mlle_cr_chunk_job_run, &jobs[t]);
+        if (handles[t] == NULL)
+            mlle_cr_chunk_job_run(&jobs[t]);
+    }
+    mlle_cr_chunk_job_run(&jobs[0]);
+    for (t = 0; t < threads; t++) {
+        mlle_thread_join(handles[t]);
+        ok = ok && jobs[t].ok;
+    }
+    if (!ok)
+        return -1;
+
+    for (i = 0; i < chunk_count; i++) {
+        pos = MLLE_CR_CHUNKED_HEADER_LENGTH + i * stride;
+        n = (i + 1 == chunk_count ? in_len - pos : stride) - MLLE_CR_GCM_TAG_LENGTH;
+        if (in_place)
+            memmove(out + out_len, in + pos, n);
+        out_len += n;
+    }
+    return (int) out_len;
+}
+
+/*
+* Decrypt format 3: header, then chunks of AES-256-GCM encrypted data, each followed by its tag.
+* Data with more than one chunk is decrypted by up to threads threads. The key is set up once,
+* and may be NULL as for mlle_cr_decrypt_gcm when threads is 1.
+* If discard is set, out is a buffer of VERIFY_SCRATCH_LEN bytes that each piece is decrypted to in turn.
+* Returns the length of the decrypted data, or -1 on an error.
+*/
+static int mlle_cr_decrypt_chunked(struct mlle_cr_session* session, const unsigned char* key,
+                                   unsigned char* in, size_t in_len, unsigned char* out, int threads,
+                                   int discard)
+{
+    size_t chunk_len = 0;
+    size_t chunk_count = 0;
+    size_t stride = 0;
+    size_t i = 0;
+    size_t pos = 0;
+    int out_len = 0;
+    int dec_len = 0;
+
+    if (!mlle_cr_chunked_layout(in, in_len, &chunk_len, &chunk_count))
+        return -1;
+    if (!mlle_cr_session_init_gcm(session))
+        return -1;
+    stride = chunk_len + MLLE_CR_GCM_TAG_LENGTH;
+
+    if (threads > DECRYPT_THREADS_MAX)
+        threads = DECRYPT_THREADS_MAX;
+    if ((size_t) threads > chunk_count)
+        threads = (int) chunk_count;
+    /* In place the output starts at the first chunk, and must not start after it otherwise. */
+    if (!discard && threads > 1 && (out <= in + MLLE_CR_CHUNKED_HEADER_LENGTH || out >= in + in_len))
+        return mlle_cr_decrypt_chunked_parallel(session, key, in, in_len, out, chunk_len, chunk_count, threads);
+
+    for (i = 0; i < chunk_count; i++) {
+        pos = MLLE_CR_CHUNKED_HEADER_LENGTH + i * stride;
+        dec_len = mlle_cr_decrypt_chunk_ctx(session->gcm_ctx, i == 0 ? key : NULL, in, i, i + 1 == chunk_count,
+                                            in + pos, i + 1 == chunk_count ? in_len - pos : stride,
+                                            discard ? out : out + out_len, discard);
+        if (dec_len < 0)
+            return -1;
+        out_len += dec_len;
+    }
+
+    return out_len;
+}
+
+
+/*
+* The key that the session of a context was last set up with in mlle_cr_decrypt_batch, as of its
+* key_serial, so that consecutive files with the same key need no new key setup.
+*/
+struct mlle_cr_batch_key {
+    unsigned char key[MLLE_CR_KEY_LEN];
+    int format;
+    unsigned long serial;
+};
+
+/*
+* Decrypt as mlle_cr_decrypt, or if discard is set only verify: out is then a buffer of VERIFY_SCRATCH_LEN
+* bytes that the data is decrypted to a piece at a time, and the key mask of a package.moc is not stored.
+* If batch_key is not NULL, the key setup of the session is reused when the key has not changed.
+*/
+static int mlle_cr_decrypt_data(
     mlle_cr_context* context,
     const char* rel_file_path,
     char* in,
     size_t in_len,
-    char* out)
+    char* out,
+    int discard,
+    struct mlle_cr_batch_key* batch_key)
 {
     /* TODO: Enable better error messages. */
-    EVP_CIPHER_CTX *c_ctx;
-    HMAC_CTX *h_ctx;
-    unsigned char *iv_in;
-    unsigned char *enc_in;
-    unsigned char *mac_in;
-    unsigned char *out_u = (unsigned char*) out;
-    unsigned char *mac = NULL;
-    const EVP_CIPHER *cipher;
-    int iv_len;
-    const EVP_MD *hash;
-    unsigned int mac_len;
-    int enc_len = 0;
+    struct mlle_cr_session local_session = { 0 };
+    struct mlle_cr_session *session = context ? &context->session : &local_session;
     int out_len = 0;
-    int dec_len = 0;
     int res = -1;
-    size_t rel_file_path_len = 0;
     int restore_mask_flag = 0;
+    int threads = 1;
+    int format = 0;
+    const unsigned char *key = NULL;
+    mlle_stats_ns start = 0;
     DECLARE_MLLE_CR_KEY();
 
-    /* Init structures. */
-    c_ctx = EVP_CIPHER_CTX_new(); 
-    h_ctx = HMAC_CTX_new(); 
-    EVP_CIPHER_CTX_init(c_ctx);
-    HMAC_CTX_init(h_ctx);
-
-    /* Select algorithms and get parameters. */
-    cipher = MLLE_CR_CIPHER;
-    iv_len = EVP_CIPHER_iv_length(cipher);
-    hash = MLLE_CR_HASH;
-    mac_len = (unsigned int) EVP_MD_size(hash);
-
-    /* Split incoming data. */
-    iv_in   = (unsigned char*) in;
     if (in) {
-        enc_in = iv_in + iv_len;
-        mac_in = iv_in + in_len - mac_len;
-        enc_len = (int)(in_len - iv_len - mac_len);
-
         /* Set up decryption and HMAC calculation. */
-        INITIALIZE_MLLE_CR_KEY();
+        mlle_cr_key_get(context ? context->key : NULL, MLLE_CR_KEY);
     }
 #ifndef DISABLE_DEMASK_KEY
     if (context && rel_file_path) {
+        start = mlle_stats_now();
         restore_mask_flag = mlle_demask_key(context, rel_file_path, MLLE_CR_KEY);
+        mlle_stats_phase(MLLE_STATS_PHASE_DEMASK, start);
+        if (discard && restore_mask_flag < 0) {
+            CLEAR_MLLE_CR_KEY();
+            return -1;
+        }
     }
 #endif
     if (!in) return 0;
 
-    if (!EVP_DecryptInit_ex(c_ctx, cipher, NULL, MLLE_CR_KEY, iv_in))
-        goto error;
-    mac = (unsigned char*) malloc(mac_len);
-    if (!mac)
-        goto error;
-    if (!HMAC_Init_ex(h_ctx, MLLE_CR_KEY, MLLE_CR_KEY_LEN, hash, NULL))
-        goto error;
-    if (!HMAC_Update(h_ctx, iv_in, iv_len))
-        goto error;
+    mlle_trace(MLLE_TRACE_DECRYPT_BEGIN, mlle_trace_hash(rel_file_path),
+               (long long) in_len, 0);
+    start = mlle_stats_now();
 
-    /* Decrypt data. */
-    if (!EVP_DecryptUpdate(c_ctx, out_u, &dec_len, enc_in, enc_len))
-        goto error;
-    out_len = dec_len;
-    if (!EVP_DecryptFinal_ex(c_ctx, out_u + out_len, &dec_len))
-        goto error;
-    out_len += dec_len;
+    format = mlle_cr_format((unsigned char*) in, in_len);
+    if (format == MLLE_CR_FORMAT_GCM_CHUNKED && context && in_len >= context->parallel_min_len)
+        threads = context->decrypt_threads;
+    key = MLLE_CR_KEY;
+    if (batch_key && batch_key->serial == session->key_serial && batch_key->format == format && threads == 1
+        && memcmp(batch_key->key, MLLE_CR_KEY, MLLE_CR_KEY_LEN) == 0)
+        key = NULL;
 
-    /* Calculate and check HMAC. */
-    if (!HMAC_Update(h_ctx, out_u, out_len))
-        goto error;
-    if (!HMAC_Final(h_ctx, mac, &mac_len))
+    switch (format) {
+    case MLLE_CR_FORMAT_CBC_HMAC:
+        out_len = mlle_cr_decrypt_cbc(session, key, (unsigned char*) in, in_len, (unsigned char*) out, discard);
+        break;
+    case MLLE_CR_FORMAT_GCM:
+        out_len = mlle_cr_decrypt_gcm(session, key, (unsigned char*) in, in_len, (unsigned char*) out, discard);
+        break;
+    case MLLE_CR_FORMAT_GCM_CHUNKED:
+        out_len = mlle_cr_decrypt_chunked(session, key, (unsigned char*) in, in_len, (unsigned char*) out,
+                                          threads, discard);
+        break;
+    default:
+        out_len = -1;
+        break;
+    }
+    /* After a failure it is not known how far the key setup got. */
+    if (key != NULL || out_len < 0)
+        session->key_serial++;
+    if (out_len < 0)
         goto error;
-    if (memcmp(mac, mac_in, mac_len))
-        goto error;    
+    if (batch_key && key != NULL && threads == 1) {
+        memcpy(batch_key->key, MLLE_CR_KEY, MLLE_CR_KEY_LEN);
+        batch_key->format = format;
+        batch_key->serial = session->key_serial;
+    }
 
 #ifndef DISABLE_DEMASK_KEY
     /* check if this is a package.moc file and save the key into cache */
     if (restore_mask_flag) {
+        if (out_len < MLLE_CR_KEY_LEN)
+            goto error;
         out_len -= MLLE_CR_KEY_LEN; /* take out key length from the data sent back*/
-        if (mlle_store_keymask(context, rel_file_path, out + out_len) < 0)
+        if (!discard && mlle_store_keymask(context, rel_file_path, out + out_len) < 0)
             goto error;
     }
 #endif
 
     res = out_len;
+    mlle_stats_phase(MLLE_STATS_PHASE_DECRYPT, start);
     /* Cleanup. */
 error:
+    mlle_trace(MLLE_TRACE_DECRYPT_END, mlle_trace_hash(rel_file_path), res, 0);
     CLEAR_MLLE_CR_KEY();
-    EVP_CIPHER_CTX_cleanup(c_ctx);
-    EVP_CIPHER_CTX_free(c_ctx);
-    HMAC_CTX_free(h_ctx);
-    free(mac);
+    if (session == &local_session)
+        mlle_cr_session_free(session);
 
     return res;
 }
+
+
+/*
+* Decrypt the data pointed to by in to out, where in_len is the length of the data pointed to by in.
+*  - key_cache - contains the table of key masks to be used in different directories.
+*  - rel_file_path - relative path to the file within library used for finding the needed key_mask
+*
+* The data pointed to by in is assumed to be in one of the formats in mlle_cr_crypt.h, which is detected
+* from its header. Format 1 consists of IV, encrypted mask + data and HMAC, in that order.
+* The buffer pointed to by out must be large enough to hold the masc + the decrypted data and its padding, i.e. in_len bytes.
+* The in and out buffers may not overlap, except as done by mlle_cr_decrypt_inplace.
+*
+* Returns the length of the decrypted data, or -1 on an error.
+*/
+int mlle_cr_decrypt(
+    mlle_cr_context* context,
+    const char* rel_file_path,
+    char* in,
+    size_t in_len,
+    char* out)
+{
+    return mlle_cr_decrypt_data(context, rel_file_path, in, in_len, out, 0, NULL);
+}
+
+
+/*
+* Verify by decrypting to a small scratch buffer, so that no buffer for the plaintext is needed.
+*/
+int mlle_cr_verify(
+    mlle_cr_context* context,
+    const char* rel_file_path,
+    const char* in,
+    size_t in_len)
+{
+    char scratch[VERIFY_SCRATCH_LEN];
+
+    if (in == NULL)
+        return -1;
+    return mlle_cr_decrypt_data(context, rel_file_path, (char*) in, in_len, scratch, 1, NULL);
+}
+
+
+/*
+* Decrypt files one after the other with the session of the context. The key masks of a directory
+* are looked up once and cached as usual, and when consecutive files have the same key the cipher
+* and MAC contexts keep their key schedules, so only the IV or nonce is set for each file.
+*/
+int mlle_cr_decrypt_batch(
+    mlle_cr_context* context,
+    size_t n,
+    const char** rel_file_paths,
+    char** ins,
+    const size_t* in_lens,
+    char** outs,
+    int* results)
+{
+    struct mlle_cr_batch_key batch_key;
+    size_t i = 0;
+    int failed = 0;
+
+    if (context == NULL || (n > 0 && (rel_file_paths == NULL || ins == NULL || in_lens == NULL
+                                      || outs == NULL || results == NULL)))
+        return -1;
+
+    /* Format 0 matches no file, so the first file sets up its key. */
+    memset(&batch_key, 0, sizeof(batch_key));
+    for (i = 0; i < n; i++) {
+        results[i] = mlle_cr_decrypt_data(context, rel_file_paths[i], ins[i], in_lens[i], outs[i], 0, &batch_key);
+        if (results[i] < 0)
+            failed++;
+    }
+    memset(&batch_key, 0, sizeof(batch_key));
+
+    return failed;
+}
+
+
+/*
+* Decrypt in place by letting the plaintext overwrite the ciphertext, which starts right after the
+* IV (format 1) or the header and nonce (formats 2 and 3). CBC decryption of a block only needs the previous
+* ciphertext block, which EVP keeps a copy of, GCM is a stream cipher, and the plaintext is never
+* longer than the ciphertext, so neither the IV nor the MAC is overwritten before it is used. In format 3
+* each chunk is decrypted into the space freed by the tags of the chunks before it.
+*/
+int mlle_cr_decrypt_inplace(
+    mlle_cr_context* context,
+    const char* rel_file_path,
+    char* buffer,
+    size_t len,
+    char** out)
+{
+    int offset = 0;
+
+    if (buffer == NULL)
+        return -1;
+    offset = mlle_cr_data_offset(mlle_cr_format((unsigned char*) buffer, len));
+    if (offset < 0 || len < (size_t) offset)
+        return -1;
+    *out = buffer + offset;
+    return mlle_cr_decrypt(context, rel_file_path, buffer, len, *out);
+}
+
+
+int mlle_cr_chunk_info(
+    const char* header,
+    size_t header_len,
+    size_t in_len,
+    size_t* enc_chunk_len,
+    size_t* chunk_count)
+{
+    size_t chunk_len = 0;
+
+    if (header == NULL || header_len < MLLE_CR_HEADER_LENGTH)
+        return -1;
+    if (mlle_cr_format((const unsigned char*) header, header_len) != MLLE_CR_FORMAT_GCM_CHUNKED)
+        return 0;
+    if (header_len < MLLE_CR_CHUNKED_HEADER_LENGTH
+        || !mlle_cr_chunked_layout((const unsigned char*) header, in_len, &chunk_len, chunk_count))
+        return -1;
+    *enc_chunk_len = chunk_len + MLLE_CR_GCM_TAG_LENGTH;
+    return 1;
+}
+
+
+/*
+* Decrypt chunk number index of format 3 data. The key mask at the end of package.moc files is
+* cut off rather than stored, so that chunks can be decrypted in any order.
+*/
+int mlle_cr_decrypt_chunk(
+    mlle_cr_context* context,
+    const char* rel_file_path,
+    const char* header,
+    size_t in_len,
+    size_t index,
+    const char* chunk,
+    size_t chunk_len,
+    char* out)
+{
+    struct mlle_cr_session local_session = { 0 };
+    struct mlle_cr_session *session = context ? &context->session : &local_session;
+    size_t full_len = 0;
+    size_t chunk_count = 0;
+    size_t data_len = 0;
+    int out_len = -1;
+    int restore_mask_flag = 0;
+    mlle_stats_ns start = 0;
+    DECLARE_MLLE_CR_KEY();
+
+    if (header == NULL || chunk == NULL || out == NULL)
+        return -1;
+    if (mlle_cr_format((const unsigned char*) header, MLLE_CR_CHUNKED_HEADER_LENGTH) != MLLE_CR_FORMAT_GCM_CHUNKED
+        || !mlle_cr_chunked_layout((const unsigned char*) header, in_len, &full_len, &chunk_count))
+        return -1;
+    if (index >= chunk_count)
+        return -1;
+    if (index + 1 < chunk_count ? chunk_len != full_len + MLLE_CR_GCM_TAG_LENGTH
+        : chunk_len != in_len - MLLE_CR_CHUNKED_HEADER_LENGTH - index * (full_len + MLLE_CR_GCM_TAG_LENGTH))
+        return -1;
+
+    mlle_cr_key_get(context ? context->key : NULL, MLLE_CR_KEY);
+#ifndef DISABLE_DEMASK_KEY
+    if (context && rel_file_path) {
+        start = mlle_stats_now();
+        restore_mask_flag = mlle_demask_key(context, rel_file_path, MLLE_CR_KEY);
+        mlle_stats_phase(MLLE_STATS_PHASE_DEMASK, start);
+        if (restore_mask_flag < 0)
+            goto error;
+    }
+#endif
+
+    start = mlle_stats_now();
+    if (!mlle_cr_session_init_gcm(session))
+        goto error;
+    session->key_serial++;
+    out_len = mlle_cr_decrypt_chunk_ctx(session->gcm_ctx, MLLE_CR_KEY, (const unsigned char*) header,
+                                        index, index + 1 == chunk_count, (const unsigned char*) chunk,
+                                        chunk_len, (unsigned char*) out, 0);
+    if (out_len < 0)
+        goto error;
+
+    if (restore_mask_flag) {
+        /* Cut off the part of the key mask that is in this chunk. */
+        data_len = in_len - MLLE_CR_CHUNKED_HEADER_LENGTH - chunk_count * MLLE_CR_GCM_TAG_LENGTH;
+        if (data_len < MLLE_CR_KEY_LEN) {
+            out_len = -1;
+            goto error;
+        }
+        data_len -= MLLE_CR_KEY_LEN;
+        if (index * full_len >= data_len)
+            out_len = 0;
+        else if (data_len - index * full_len < (size_t) out_len)
+            out_len = (int) (data_len - index * full_len);
+    }
+    mlle_stats_phase(MLLE_STATS_PHASE_DECRYPT, start);
+
+error:
+    CLEAR_MLLE_CR_KEY();
+    if (session == &local_session)
+        mlle_cr_session_free(session);
+
+    return out_len;
+}
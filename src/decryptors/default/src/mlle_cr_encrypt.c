@@ -27,8 +27,11 @@
 #include <openssl/rand.h>
 #include "mlle_cr_crypt.h"
 #include "mlle_cr_decrypt.h"
+#include "mlle_cr_encrypt.h"
 #include "mlle_cr_context.h"
 #include "mlle_error.h"
+#include "mlle_thread.h"
+#include "mlle_trace.h"
 
 #include "random_key_file.h"
 
@@ -60,13 +63,14 @@ static int mlle_cr_seed() {
 #define mlle_cr_seed() (1)
 #endif
 
-/* Length of buffers to use. */
-#define READ_BUF_LEN (256)
+/*
+ * Length of buffers to use. Large, so that a file takes few stdio and EVP calls, which
+ * otherwise dominate the time to encrypt. The encrypted data is at most one block longer.
+ */
+#define READ_BUF_LEN (1024 * 1024)
 #define CRYPT_BUF_LEN (READ_BUF_LEN + 32)
 
 
-void mlle_debug_log_key(const unsigned char* key);
-extern FILE* mlle_log;
 /*
     Mask the provided key based on the context and rel_file_path. 
     Returns:
@@ -87,10 +91,7 @@ int mlle_mask_key(mlle_cr_context* context, const char* rel_file_path, unsigned
     int ret = 0;
     int is_package_mo_file = 0;
 
-    if (mlle_log) {
-        fprintf(mlle_log, "mlle_mask_key: got key for %s \n", rel_file_path);
-        mlle_debug_log_key(key);
-    }
+    mlle_trace(MLLE_TRACE_MASK_KEY, mlle_trace_hash(rel_file_path), 0, 0);
 
 
     while (rel_file_path[i] && (i < MLLE_LONG_FILE_NAME_MAX)) {
@@ -136,6 +137,11 @@ int mlle_mask_key(mlle_cr_context* context, const char* rel_file_path, unsigned
         if (map_item == NULL) {
             return -1;
         }
+        map_item->key_mask = mlle_cr_key_mask_alloc(context->key);
+        if (map_item->key_mask == NULL) {
+            free(map_item);
+            return -1;
+        }
         map_item->relpath = map_item->buffer;
         memcpy(map_item->buffer, path, last_slash_index);
         memcpy(map_item->key_mask, store_mask, MLLE_CR_KEY_LEN);
@@ -143,10 +149,7 @@ int mlle_mask_key(mlle_cr_context* context, const char* rel_file_path, unsigned
         HASH_ADD_KEYPTR(hh, key_mask_map, map_item->relpath, last_slash_index, map_item);
         context->keymask_map = key_mask_map;
 
-        if (mlle_log) {
-            fprintf(mlle_log, "mlle_mask_key: generated and stored mask for %s \n", map_item->relpath);
-            mlle_debug_log_key(store_mask);
-        }
+        mlle_trace(MLLE_TRACE_MASK_KEY, mlle_trace_hash(map_item->relpath), 1, 0);
 
         return 1;
     }
@@ -155,6 +158,13 @@ int mlle_mask_key(mlle_cr_context* context, const char* rel_file_path, unsigned
     if (map_item == NULL) {
         /* nothing in the table - grab from parent dir and store */
         map_item = (struct mlle_key_mask_map*)calloc(1, sizeof(struct mlle_key_mask_map) + rel_path_len + 1);
+        if (map_item != NULL) {
+            map_item->key_mask = mlle_cr_key_mask_alloc(context->key);
+            if (map_item->key_mask == NULL) {
+                free(map_item);
+                map_item = NULL;
+            }
+        }
         if (map_item == NULL) {
             fprintf(stderr, "Could not allocate memory when processing %s\n", path);
             return -1;
@@ -170,10 +180,7 @@ int mlle_mask_key(mlle_cr_context* context, const char* rel_file_path, unsigned
                 return -1;
             }
         }
-        if (mlle_log) {
-            fprintf(mlle_log, "mlle_mask_key: storing mask based on parent for %s \n", map_item->relpath);
-            mlle_debug_log_key(map_item->key_mask);
-        }
+        mlle_trace(MLLE_TRACE_MASK_KEY, mlle_trace_hash(map_item->relpath), 2, 0);
 
         HASH_ADD_KEYPTR(hh, key_mask_map, map_item->relpath, last_slash_index, map_item);
         context->keymask_map = key_mask_map;
@@ -183,23 +190,343 @@ int mlle_mask_key(mlle_cr_context* context, const char* rel_file_path, unsigned
     for (i = 0; i < MLLE_CR_KEY_LEN; ++i) {
         key[i] = key[i] ^ map_item->key_mask[i];
     }
-    if (mlle_log) {
-        fprintf(mlle_log, "mlle_mask_key: applied key mask for %s \n", rel_file_path);
-        mlle_debug_log_key(key);
-    }
+    mlle_trace(MLLE_TRACE_MASK_KEY, mlle_trace_hash(rel_file_path), 3, 0);
     return 0;
 }
 
+/*
+ * mlle_mask_key for one file, holding the mutex of the context, so that threads
+ * encrypting files with the same context can share its key mask table.
+ */
+static int mlle_mask_key_locked(mlle_cr_context* context, const char* rel_file_path, unsigned char* key,
+                                unsigned char* store_mask) {
+    int ret = 0;
+
+    mlle_mutex_lock(context->mask_mutex);
+    ret = mlle_mask_key(context, rel_file_path, key, store_mask);
+    mlle_mutex_unlock(context->mask_mutex);
+    return ret;
+}
+
+int mlle_cr_set_format(mlle_cr_context* context, int format) {
+    if (format != MLLE_CR_FORMAT_CBC_HMAC && format != MLLE_CR_FORMAT_GCM
+        && format != MLLE_CR_FORMAT_GCM_CHUNKED)
+        return 0;
+    context->format = format;
+    return 1;
+}
+
 
 /*
- * Read data from stream in until eof, encrypt store_mask + data, and write IV, encrypted data and HMAC (in that order) to stream out.
+ * Where mlle_cr_encrypt reads plaintext from and writes encrypted data to: streams, or buffers
+ * for mlle_cr_encrypt_mem.
+ */
+struct mlle_cr_io {
+    FILE* in;
+    const unsigned char* in_buf;
+    size_t in_len;
+    size_t in_pos;
+    FILE* out;
+    unsigned char* out_buf;
+    size_t out_cap;
+    size_t out_pos;
+};
+
+/*
+ * Read up to len bytes of plaintext. Sets *data to point to them, which is buf when reading from
+ * a stream and into the input buffer otherwise. Returns the number of bytes read, which is less
+ * than len only at the end, or -1 on error.
+ */
+static int mlle_cr_io_read(struct mlle_cr_io* io, unsigned char* buf, int len, const unsigned char** data)
+{
+    int read_len = 0;
+
+    if (io->in) {
+        read_len = (int) fread(buf, 1, len, io->in);
+        if (read_len < len && ferror(io->in))
+            return -1;
+        *data = buf;
+        return read_len;
+    }
+    read_len = io->in_len - io->in_pos < (size_t) len ? (int) (io->in_len - io->in_pos) : len;
+    *data = io->in_buf + io->in_pos;
+    io->in_pos += read_len;
+    return read_len;
+}
+
+/* Write len bytes of encrypted data. Returns zero on error. */
+static int mlle_cr_io_write(struct mlle_cr_io* io, const unsigned char* data, size_t len)
+{
+    if (io->out)
+        return len == 0 || fwrite(data, 1, len, io->out) == len;
+    if (io->out_cap - io->out_pos < len)
+        return 0;
+    memcpy(io->out_buf + io->out_pos, data, len);
+    io->out_pos += len;
+    return 1;
+}
+
+
+/*
+ * Read data from io until the end, encrypt data + store_mask with AES-256-GCM, and write
+ * header, nonce, encrypted data and tag (in that order) to io.
  *
  * Returns zero on error.
  */
-int mlle_cr_encrypt(mlle_cr_context* context, 
-                    const char* rel_file_path,
-                    FILE* in, 
-                    FILE* out)
+static int mlle_cr_encrypt_gcm(mlle_cr_context* context,
+                               const char* rel_file_path,
+                               struct mlle_cr_io* io)
+{
+    EVP_CIPHER_CTX *c_ctx;
+    unsigned char header[MLLE_CR_HEADER_LENGTH] = { 0 };
+    unsigned char nonce[MLLE_CR_GCM_NONCE_LENGTH];
+    unsigned char tag[MLLE_CR_GCM_TAG_LENGTH];
+    unsigned char *read_buf = NULL;
+    unsigned char *crypt_buf = NULL;
+    const unsigned char *data;
+    int res = 0;
+    int read_len;
+    int crypt_len;
+    unsigned char store_mask[MLLE_CR_KEY_LEN];
+    int store_mask_flag = 0;
+    DECLARE_MLLE_CR_KEY();
+
+    c_ctx = EVP_CIPHER_CTX_new();
+    read_buf = (unsigned char*) malloc(READ_BUF_LEN);
+    crypt_buf = (unsigned char*) malloc(CRYPT_BUF_LEN);
+    if (c_ctx == NULL || read_buf == NULL || crypt_buf == NULL)
+        goto error;
+
+    if (!mlle_cr_seed())
+        goto error;
+
+    /* Write header and nonce. */
+    memcpy(header, MLLE_CR_MAGIC, MLLE_CR_MAGIC_LENGTH);
+    header[MLLE_CR_MAGIC_LENGTH] = MLLE_CR_FORMAT_GCM;
+    if (RAND_bytes(nonce, MLLE_CR_GCM_NONCE_LENGTH) != 1)
+        goto error;
+    if (!mlle_cr_io_write(io, header, MLLE_CR_HEADER_LENGTH))
+        goto error;
+    if (!mlle_cr_io_write(io, nonce, MLLE_CR_GCM_NONCE_LENGTH))
+        goto error;
+
+    /* Set up encryption, with the header as additional authenticated data. */
+    mlle_cr_key_get(context->key, MLLE_CR_KEY);
+#ifndef DISABLE_DEMASK_KEY
+    store_mask_flag = mlle_mask_key_locked(context, rel_file_path, MLLE_CR_KEY, store_mask);
+    if (store_mask_flag < 0) {
+        goto error;
+    }
+#endif
+    if (!EVP_EncryptInit_ex(c_ctx, MLLE_CR_GCM_CIPHER, NULL, MLLE_CR_KEY, nonce))
+        goto error;
+    if (!EVP_EncryptUpdate(c_ctx, NULL, &crypt_len, header, MLLE_CR_HEADER_LENGTH))
+        goto error;
+
+    /* Process file. */
+    while ((read_len = mlle_cr_io_read(io, read_buf, READ_BUF_LEN, &data)) > 0) {
+        if (!EVP_EncryptUpdate(c_ctx, crypt_buf, &crypt_len, data, read_len))
+            goto error;
+        if (!mlle_cr_io_write(io, crypt_buf, crypt_len))
+            goto error;
+    }
+    if (read_len < 0)
+        goto error;
+
+#ifndef DISABLE_DEMASK_KEY
+    if (store_mask_flag) {
+        /* Encrypt and write store_mask. */
+        if (!EVP_EncryptUpdate(c_ctx, crypt_buf, &crypt_len, store_mask, MLLE_CR_KEY_LEN))
+            goto error;
+        if (!mlle_cr_io_write(io, crypt_buf, crypt_len))
+            goto error;
+    }
+#endif
+
+    /* Finalize encryption and write the tag. */
+    if (!EVP_EncryptFinal_ex(c_ctx, crypt_buf, &crypt_len))
+        goto error;
+    if (!mlle_cr_io_write(io, crypt_buf, crypt_len))
+        goto error;
+    if (!EVP_CIPHER_CTX_ctrl(c_ctx, EVP_CTRL_AEAD_GET_TAG, MLLE_CR_GCM_TAG_LENGTH, tag))
+        goto error;
+    if (!mlle_cr_io_write(io, tag, MLLE_CR_GCM_TAG_LENGTH))
+        goto error;
+
+    /* Operation succeded. */
+    res = 1;
+
+    /* Cleanup. */
+error:
+    CLEAR_MLLE_CR_KEY();
+    EVP_CIPHER_CTX_free(c_ctx);
+    free(read_buf);
+    free(crypt_buf);
+
+    return res;
+}
+
+
+/*
+ * Read up to len bytes of plaintext to buf: first from io, and after its end from the len_mask bytes
+ * at mask + *mask_pos. Returns the number of bytes read, which is less than len only at the end, or -1 on error.
+ */
+static int mlle_cr_read_plain(struct mlle_cr_io* io, const unsigned char* mask, int len_mask, int* mask_pos,
+                              unsigned char* buf, int len)
+{
+    const unsigned char *data;
+    int read_len = 0;
+    int n = 0;
+
+    if (*mask_pos == 0) {
+        read_len = mlle_cr_io_read(io, buf, len, &data);
+        if (read_len < 0)
+            return -1;
+        if (data != buf)
+            memcpy(buf, data, read_len);
+        if (read_len == len)
+            return read_len;
+    }
+    n = len - read_len < len_mask - *mask_pos ? len - read_len : len_mask - *mask_pos;
+    memcpy(buf + read_len, mask + *mask_pos, n);
+    *mask_pos += n;
+    return read_len + n;
+}
+
+
+/*
+ * Read data from io until the end, and write header, nonce prefix and data + store_mask
+ * encrypted in chunks of MLLE_CR_CHUNK_LENGTH bytes (format 3) to io.
+ *
+ * Returns zero on error.
+ */
+static int mlle_cr_encrypt_chunked(mlle_cr_context* context,
+                                   const char* rel_file_path,
+                                   struct mlle_cr_io* io)
+{
+    EVP_CIPHER_CTX *c_ctx;
+    unsigned char header[MLLE_CR_CHUNKED_HEADER_LENGTH] = { 0 };
+    unsigned char nonce[MLLE_CR_GCM_NONCE_LENGTH];
+    unsigned char tag[MLLE_CR_GCM_TAG_LENGTH];
+    unsigned char last_flag = 0;
+    unsigned char *plain_buf = NULL;
+    unsigned char *next_buf = NULL;
+    unsigned char *crypt_buf = NULL;
+    unsigned char *tmp = NULL;
+    unsigned long index = 0;
+    int res = 0;
+    int plain_len;
+    int next_len;
+    int crypt_len;
+    int final_len;
+    unsigned char store_mask[MLLE_CR_KEY_LEN];
+    int store_mask_flag = 0;
+    int mask_pos = 0;
+    DECLARE_MLLE_CR_KEY();
+
+    c_ctx = EVP_CIPHER_CTX_new();
+    plain_buf = (unsigned char*) malloc(MLLE_CR_CHUNK_LENGTH);
+    next_buf = (unsigned char*) malloc(MLLE_CR_CHUNK_LENGTH);
+    crypt_buf = (unsigned char*) malloc(MLLE_CR_CHUNK_LENGTH);
+    if (c_ctx == NULL || plain_buf == NULL || next_buf == NULL || crypt_buf == NULL)
+        goto error;
+
+    if (!mlle_cr_seed())
+        goto error;
+
+    /* Write header: magic, format, chunk length and nonce prefix. */
+    memcpy(header, MLLE_CR_MAGIC, MLLE_CR_MAGIC_LENGTH);
+    header[MLLE_CR_MAGIC_LENGTH] = MLLE_CR_FORMAT_GCM_CHUNKED;
+    header[MLLE_CR_HEADER_LENGTH] = MLLE_CR_CHUNK_LENGTH & 0xff;
+    header[MLLE_CR_HEADER_LENGTH + 1] = (MLLE_CR_CHUNK_LENGTH >> 8) & 0xff;
+    header[MLLE_CR_HEADER_LENGTH + 2] = (MLLE_CR_CHUNK_LENGTH >> 16) & 0xff;
+    header[MLLE_CR_HEADER_LENGTH + 3] = (MLLE_CR_CHUNK_LENGTH >> 24) & 0xff;
+    if (RAND_bytes(header + MLLE_CR_HEADER_LENGTH + 4, MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH) != 1)
+        goto error;
+    if (!mlle_cr_io_write(io, header, MLLE_CR_CHUNKED_HEADER_LENGTH))
+        goto error;
+    memcpy(nonce, header + MLLE_CR_HEADER_LENGTH + 4, MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH);
+
+    mlle_cr_key_get(context->key, MLLE_CR_KEY);
+#ifndef DISABLE_DEMASK_KEY
+    store_mask_flag = mlle_mask_key_locked(context, rel_file_path, MLLE_CR_KEY, store_mask);
+    if (store_mask_flag < 0) {
+        goto error;
+    }
+#endif
+    if (!EVP_EncryptInit_ex(c_ctx, MLLE_CR_GCM_CIPHER, NULL, MLLE_CR_KEY, NULL))
+        goto error;
+
+    /* Process file. A chunk is known to be the last one when there is no data after it. */
+    plain_len = mlle_cr_read_plain(io, store_mask, store_mask_flag ? MLLE_CR_KEY_LEN : 0, &mask_pos,
+                                   plain_buf, MLLE_CR_CHUNK_LENGTH);
+    if (plain_len < 0)
+        goto error;
+    while (!last_flag) {
+        if (index > 0xffffffffUL)
+            goto error;
+        next_len = 0;
+        if (plain_len == MLLE_CR_CHUNK_LENGTH) {
+            next_len = mlle_cr_read_plain(io, store_mask, store_mask_flag ? MLLE_CR_KEY_LEN : 0, &mask_pos,
+                                          next_buf, MLLE_CR_CHUNK_LENGTH);
+            if (next_len < 0)
+                goto error;
+        }
+        last_flag = (next_len == 0);
+
+        /* Encrypt and write the chunk and its tag. */
+        nonce[MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH] = (index >> 24) & 0xff;
+        nonce[MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH + 1] = (index >> 16) & 0xff;
+        nonce[MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH + 2] = (index >> 8) & 0xff;
+        nonce[MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH + 3] = index & 0xff;
+        if (!EVP_EncryptInit_ex(c_ctx, NULL, NULL, NULL, nonce))
+            goto error;
+        if (!EVP_EncryptUpdate(c_ctx, NULL, &crypt_len, header, MLLE_CR_CHUNKED_HEADER_LENGTH))
+            goto error;
+        if (!EVP_EncryptUpdate(c_ctx, NULL, &crypt_len, &last_flag, 1))
+            goto error;
+        if (!EVP_EncryptUpdate(c_ctx, crypt_buf, &crypt_len, plain_buf, plain_len))
+            goto error;
+        if (!EVP_EncryptFinal_ex(c_ctx, crypt_buf + crypt_len, &final_len))
+            goto error;
+        crypt_len += final_len;
+        if (!EVP_CIPHER_CTX_ctrl(c_ctx, EVP_CTRL_AEAD_GET_TAG, MLLE_CR_GCM_TAG_LENGTH, tag))
+            goto error;
+        if (!mlle_cr_io_write(io, crypt_buf, crypt_len))
+            goto error;
+        if (!mlle_cr_io_write(io, tag, MLLE_CR_GCM_TAG_LENGTH))
+            goto error;
+
+        tmp = plain_buf;
+        plain_buf = next_buf;
+        next_buf = tmp;
+        plain_len = next_len;
+        index++;
+    }
+
+    /* Operation succeded. */
+    res = 1;
+
+    /* Cleanup. */
+error:
+    CLEAR_MLLE_CR_KEY();
+    EVP_CIPHER_CTX_free(c_ctx);
+    free(plain_buf);
+    free(next_buf);
+    free(crypt_buf);
+
+    return res;
+}
+
+
+/*
+ * Read data from io until the end, encrypt data + store_mask, and write IV, encrypted data and HMAC (in that order) to io.
+ *
+ * Returns zero on error.
+ */
+static int mlle_cr_encrypt_cbc(mlle_cr_context* context,
+                               const char* rel_file_path,
+                               struct mlle_cr_io* io)
 {
     /* TODO: Enable better error messages. */
     EVP_CIPHER_CTX *c_ctx;
@@ -210,8 +537,9 @@ int mlle_cr_encrypt(mlle_cr_context* context,
     int iv_len;
     const EVP_MD *hash;
     unsigned int mac_len;
-    unsigned char read_buf[READ_BUF_LEN];
-    unsigned char crypt_buf[CRYPT_BUF_LEN];
+    unsigned char *read_buf = NULL;
+    unsigned char *crypt_buf = NULL;
+    const unsigned char *data;
     int res = 0;
     int read_len;
     int crypt_len;
@@ -230,19 +558,24 @@ int mlle_cr_encrypt(mlle_cr_context* context,
     hash = MLLE_CR_HASH;
     mac_len = (unsigned int) EVP_MD_size(hash);
 
+    read_buf = (unsigned char*) malloc(READ_BUF_LEN);
+    crypt_buf = (unsigned char*) malloc(CRYPT_BUF_LEN);
+    if (read_buf == NULL || crypt_buf == NULL)
+        goto error;
+
     if (!mlle_cr_seed())
         goto error;
 
     /* Create IV and write it to file. */
     iv = (unsigned char*) malloc(iv_len);
     RAND_bytes(iv, iv_len);
-    if (fwrite(iv, iv_len, 1, out) < 1)
+    if (!mlle_cr_io_write(io, iv, iv_len))
         goto error;
 
     /* Set up encryption and HMAC calculation. */
-    INITIALIZE_MLLE_CR_KEY();
+    mlle_cr_key_get(context->key, MLLE_CR_KEY);
 #ifndef DISABLE_DEMASK_KEY
-    store_mask_flag = mlle_mask_key(context, rel_file_path, MLLE_CR_KEY, store_mask);
+    store_mask_flag = mlle_mask_key_locked(context, rel_file_path, MLLE_CR_KEY, store_mask);
     if (store_mask_flag < 0) {
         goto error;
     }
@@ -258,29 +591,26 @@ int mlle_cr_encrypt(mlle_cr_context* context,
         goto error;
 
     /* Process file. */
-    while (!feof(in)) {
-        /* Read cleartext data. */
-        read_len = (int) fread(read_buf, 1, READ_BUF_LEN, in);
-        if (read_len < READ_BUF_LEN && ferror(in))
-            goto error;
-
+    while ((read_len = mlle_cr_io_read(io, read_buf, READ_BUF_LEN, &data)) > 0) {
         /* Encrypt and write data. */
-        if (!EVP_EncryptUpdate(c_ctx, crypt_buf, &crypt_len, read_buf, read_len))
+        if (!EVP_EncryptUpdate(c_ctx, crypt_buf, &crypt_len, data, read_len))
             goto error;
-        if (fwrite(crypt_buf, 1, crypt_len, out) < (size_t) crypt_len)
+        if (!mlle_cr_io_write(io, crypt_buf, crypt_len))
             goto error;
 
         /* Update HMAC calculation. */
-        if (!HMAC_Update(h_ctx, read_buf, read_len))
+        if (!HMAC_Update(h_ctx, data, read_len))
             goto error;
     }
+    if (read_len < 0)
+        goto error;
 
 #ifndef DISABLE_DEMASK_KEY
     if (store_mask_flag) {
         /* Encrypt and write store_mask. */
         if (!EVP_EncryptUpdate(c_ctx, crypt_buf, &crypt_len, store_mask, MLLE_CR_KEY_LEN))
             goto error;
-        if (fwrite(crypt_buf, 1, crypt_len, out) < (size_t)crypt_len)
+        if (!mlle_cr_io_write(io, crypt_buf, crypt_len))
             goto error;
         /* Update HMAC calculation. */
         if (!HMAC_Update(h_ctx, store_mask, MLLE_CR_KEY_LEN))
@@ -291,13 +621,13 @@ int mlle_cr_encrypt(mlle_cr_context* context,
     /* Finalize encryption and write final data. */
     if (!EVP_EncryptFinal_ex(c_ctx, crypt_buf, &crypt_len))
         goto error;
-    if (fwrite(crypt_buf, 1, crypt_len, out) < (size_t) crypt_len)
+    if (!mlle_cr_io_write(io, crypt_buf, crypt_len))
         goto error;
 
     /* Finalize HMAC calculation and write to file. */
     if (!HMAC_Final(h_ctx, mac, &mac_len))
         goto error;
-    if (fwrite(mac, mac_len, 1, out) < 1)
+    if (!mlle_cr_io_write(io, mac, mac_len))
         goto error;
 
     /* Operation succeded. */
@@ -310,6 +640,108 @@ error:
     HMAC_CTX_free(h_ctx);
     free(mac);
     free(iv);
+    free(read_buf);
+    free(crypt_buf);
 
     return res;
 }
+
+
+/* Encrypt from io in the format selected with mlle_cr_set_format. Returns zero on error. */
+static int mlle_cr_encrypt_io(mlle_cr_context* context,
+                              const char* rel_file_path,
+                              struct mlle_cr_io* io)
+{
+    if (context->format == MLLE_CR_FORMAT_GCM)
+        return mlle_cr_encrypt_gcm(context, rel_file_path, io);
+    if (context->format == MLLE_CR_FORMAT_GCM_CHUNKED)
+        return mlle_cr_encrypt_chunked(context, rel_file_path, io);
+    return mlle_cr_encrypt_cbc(context, rel_file_path, io);
+}
+
+
+/*
+ * Read data from stream in until eof, encrypt store_mask + data, and write IV, encrypted data and HMAC (in that order) to stream out.
+ * Writes format 2 or 3 instead if selected with mlle_cr_set_format.
+ *
+ * Returns zero on error.
+ */
+int mlle_cr_encrypt(mlle_cr_context* context, 
+                    const char* rel_file_path,
+                    FILE* in, 
+                    FILE* out)
+{
+    struct mlle_cr_io io = { 0 };
+
+    io.in = in;
+    io.out = out;
+    return mlle_cr_encrypt_io(context, rel_file_path, &io);
+}
+
+
+/* Is this the package.mo of a directory, which a key mask is stored in (see mlle_mask_key)? */
+static int mlle_cr_is_package_mo(const char* rel_file_path) {
+    const char* name = rel_file_path;
+    const char* p;
+
+    for (p = rel_file_path; *p; p++) {
+        if (*p == '/' || *p == '\\')
+            name = p + 1;
+    }
+    return strcasecmp("package.mo", name) == 0;
+}
+
+
+size_t mlle_cr_encrypt_mem_size(mlle_cr_context* context,
+                                const char* rel_file_path,
+                                size_t in_len)
+{
+    size_t len = in_len;
+    size_t chunks = 0;
+    int block_len = 0;
+
+#ifndef DISABLE_DEMASK_KEY
+    if (mlle_cr_is_package_mo(rel_file_path))
+        len += MLLE_CR_KEY_LEN;
+#endif
+    switch (context->format) {
+    case MLLE_CR_FORMAT_GCM:
+        return MLLE_CR_HEADER_LENGTH + MLLE_CR_GCM_NONCE_LENGTH + len + MLLE_CR_GCM_TAG_LENGTH;
+    case MLLE_CR_FORMAT_GCM_CHUNKED:
+        chunks = len == 0 ? 1 : (len + MLLE_CR_CHUNK_LENGTH - 1) / MLLE_CR_CHUNK_LENGTH;
+        return MLLE_CR_CHUNKED_HEADER_LENGTH + len + chunks * MLLE_CR_GCM_TAG_LENGTH;
+    default:
+        /* PKCS#7 padding always adds 1 to block_len bytes. */
+        block_len = EVP_CIPHER_block_size(MLLE_CR_CIPHER);
+        return EVP_CIPHER_iv_length(MLLE_CR_CIPHER) + (len / block_len + 1) * block_len
+            + EVP_MD_size(MLLE_CR_HASH);
+    }
+}
+
+
+/*
+ * Encrypt in_len bytes at in to out, as mlle_cr_encrypt would for a stream. The capacity is checked
+ * before the key mask of a package.mo is created, so that a failed call can be retried.
+ */
+size_t mlle_cr_encrypt_mem(mlle_cr_context* context,
+                           const char* rel_file_path,
+                           const char* in,
+                           size_t in_len,
+                           char* out,
+                           size_t out_cap)
+{
+    struct mlle_cr_io io = { 0 };
+    size_t len = mlle_cr_encrypt_mem_size(context, rel_file_path, in_len);
+
+    if (in == NULL && in_len > 0)
+        return 0;
+    if (out == NULL || out_cap < len)
+        return 0;
+    io.in_buf = (const unsigned char*) in;
+    io.in_len = in_len;
+    io.out_buf = (unsigned char*) out;
+    io.out_cap = out_cap;
+    if (!mlle_cr_encrypt_io(context, rel_file_path, &io))
+        return 0;
+    return io.out_pos;
+}
@@ -0,0 +1,171 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+/* MAP_ANONYMOUS and MADV_DONTDUMP are not in XOPEN. */
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#include "mlle_cr_key.h"
+#include "mlle_io.h"
+#include "mlle_trace.h"
+#include "random_key_file.h"
+
+#if !defined(_WIN32) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* Key masks per page of struct mlle_cr_key_page, which then fills 4 KiB. */
+#define MASKS_PER_PAGE (126)
+
+struct mlle_cr_key_page {
+    struct mlle_cr_key_page *next;
+    size_t used;                            /* masks handed out */
+    int mapped;                             /* see struct mlle_cr_key */
+    unsigned char masks[MASKS_PER_PAGE][MLLE_CR_KEY_LEN];
+};
+
+struct mlle_cr_key {
+    unsigned char masked[MLLE_CR_KEY_LEN];  /* the key xor *mask */
+    unsigned char *mask;                    /* in an allocation of its own, not next to the masked key */
+    struct mlle_cr_key_page *pages;         /* see mlle_cr_key_mask_alloc, newest first */
+    int mapped;                             /* allocated with mmap/VirtualAlloc, not malloc */
+};
+
+/*
+ * Allocate len zeroed bytes on pages of their own and lock them. Locking may fail, e.g. when over
+ * RLIMIT_MEMLOCK, and is then skipped. If no page can be mapped the memory is allocated with calloc,
+ * and *mapped is set to 0 instead of 1.
+ */
+static void* mlle_cr_key_alloc(size_t len, int* mapped) {
+#ifdef _WIN32
+    void *page = VirtualAlloc(NULL, len, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (page != NULL) {
+        VirtualLock(page, len);
+        *mapped = 1;
+        return page;
+    }
+#else
+    void *page = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page != MAP_FAILED) {
+        mlock(page, len);
+#ifdef MADV_DONTDUMP
+        madvise(page, len, MADV_DONTDUMP);
+#endif
+        *mapped = 1;
+        return page;
+    }
+#endif
+    *mapped = 0;
+    return calloc(1, len);
+}
+
+/* Wipe and free memory from mlle_cr_key_alloc. */
+static void mlle_cr_key_release(void* p, size_t len, int mapped) {
+    OPENSSL_cleanse(p, len);
+    if (!mapped) {
+        free(p);
+        return;
+    }
+#ifdef _WIN32
+    VirtualUnlock(p, len);
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munlock(p, len);
+    munmap(p, len);
+#endif
+}
+
+struct mlle_cr_key* mlle_cr_key_new(void) {
+    struct mlle_cr_key *handle = NULL;
+    int mapped = 0;
+    int i = 0;
+    DECLARE_MLLE_CR_KEY();
+
+    handle = mlle_cr_key_alloc(sizeof(*handle), &mapped);
+    if (handle == NULL)
+        return NULL;
+    handle->mapped = mapped;
+    handle->mask = calloc(1, MLLE_CR_KEY_LEN);
+    if (handle->mask == NULL) {
+        mlle_cr_key_release(handle, sizeof(*handle), mapped);
+        return NULL;
+    }
+    /* Without random bytes the key is stored unmasked, which still works. */
+    if (RAND_bytes(handle->mask, MLLE_CR_KEY_LEN) != 1) {
+        memset(handle->mask, 0, MLLE_CR_KEY_LEN);
+        mlle_trace(MLLE_TRACE_KEY_UNMASKED, 0, 0, 0);
+        if (mlle_log) {
+            fprintf(mlle_log, "No random bytes to mask the key with, keeping it unmasked\n");
+        }
+    }
+    INITIALIZE_MLLE_CR_KEY();
+    for (i = 0; i < MLLE_CR_KEY_LEN; i++) {
+        handle->masked[i] = MLLE_CR_KEY[i] ^ handle->mask[i];
+    }
+    CLEAR_MLLE_CR_KEY();
+    return handle;
+}
+
+void mlle_cr_key_get(const struct mlle_cr_key* handle, unsigned char* key) {
+    int i = 0;
+
+    if (handle == NULL) {
+        DECLARE_MLLE_CR_KEY();
+        INITIALIZE_MLLE_CR_KEY();
+        memcpy(key, MLLE_CR_KEY, MLLE_CR_KEY_LEN);
+        CLEAR_MLLE_CR_KEY();
+        return;
+    }
+    for (i = 0; i < MLLE_CR_KEY_LEN; i++) {
+        key[i] = handle->masked[i] ^ handle->mask[i];
+    }
+}
+
+unsigned char* mlle_cr_key_mask_alloc(struct mlle_cr_key* handle) {
+    struct mlle_cr_key_page *page = handle->pages;
+    int mapped = 0;
+
+    if (page == NULL || page->used == MASKS_PER_PAGE) {
+        page = mlle_cr_key_alloc(sizeof(*page), &mapped);
+        if (page == NULL)
+            return NULL;
+        page->mapped = mapped;
+        page->next = handle->pages;
+        handle->pages = page;
+    }
+    return page->masks[page->used++];
+}
+
+void mlle_cr_key_free(struct mlle_cr_key* handle) {
+    struct mlle_cr_key_page *page = NULL;
+
+    if (handle == NULL)
+        return;
+    while (handle->pages != NULL) {
+        page = handle->pages;
+        handle->pages = page->next;
+        mlle_cr_key_release(page, sizeof(*page), page->mapped);
+    }
+    OPENSSL_cleanse(handle->mask, MLLE_CR_KEY_LEN);
+    free(handle->mask);
+    mlle_cr_key_release(handle, sizeof(*handle), handle->mapped);
+}
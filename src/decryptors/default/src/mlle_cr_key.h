@@ -0,0 +1,48 @@
+/*
+    Copyright (C) 2022 Modelica Association
+*/
+
+#ifndef MLLE_CR_KEY_H_
+#define MLLE_CR_KEY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * The encryption key, materialised once per mlle_cr_context instead of with
+ * INITIALIZE_MLLE_CR_KEY in every call. It is kept in memory that is locked, so
+ * that it is not swapped out, and left out of core dumps. There it is masked with
+ * random bytes that are kept in another allocation, so that the locked memory
+ * alone does not give the key. The key masks of the directories of a library are
+ * kept in locked memory of the handle too.
+ */
+struct mlle_cr_key;
+
+/*
+ * Materialise the key into a new key handle.
+ * Returns NULL if out of memory.
+ */
+struct mlle_cr_key* mlle_cr_key_new(void);
+
+/*
+ * Copy the key to key, which must hold MLLE_CR_KEY_LEN bytes. If handle is NULL, the key
+ * is materialised for this call only. The caller clears key after use.
+ */
+void mlle_cr_key_get(const struct mlle_cr_key* handle, unsigned char* key);
+
+/*
+ * Get room for a key mask of MLLE_CR_KEY_LEN zero bytes in locked memory of the handle.
+ * The room is wiped and freed with the handle.
+ * Returns NULL if out of memory.
+ */
+unsigned char* mlle_cr_key_mask_alloc(struct mlle_cr_key* handle);
+
+/* Wipe the key and the key masks, and free the handle. */
+void mlle_cr_key_free(struct mlle_cr_key* handle);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MLLE_CR_KEY_H_ */
@@ -43,8 +43,8 @@ void mlle_cr_free(mlle_cr_context* context);
  *  context - pointer to the structure allocated by mlle_cr_create
  *  relpath - pointer to the file to be processed for subdir depedent encryption.
  * The data pointed to by in is assumed to consist of IV, encrypted mask + data and HMAC, in that order.
- * The buffer pointed to by out must be large enough to hold the decrypted mask+data, which is always shorter than in_len.
- * The in and out buffers may not be the same.
+ * The buffer pointed to by out must be large enough to hold the decrypted mask+data and padding, i.e. in_len bytes.
+ * The in and out buffers may not overlap, except as done by mlle_cr_decrypt_inplace.
  *
  * Returns the length of the decrypted data, or -1 on an error.
  */
@@ -54,6 +54,86 @@ int mlle_cr_decrypt(mlle_cr_context* context,
                     size_t in_len,
                     char* out);
 
+/*
+ * Check that the data pointed to by in, laid out as for mlle_cr_decrypt, is intact and was encrypted
+ * with the key for relpath, without keeping the plaintext. in_len is the length of the data.
+ *
+ * Returns the length of the decrypted data, or -1 if the data is corrupt or on an error.
+ */
+int mlle_cr_verify(mlle_cr_context* context,
+                   const char* relpath,
+                   const char* in,
+                   size_t in_len);
+
+/*
+ * Decrypt n files, each as by mlle_cr_decrypt, for example all files of a directory of many small files.
+ * For file i, relpaths[i] is its path, ins[i] and in_lens[i] its encrypted data, and outs[i] the buffer to
+ * decrypt it to. results[i] is set to the length of the decrypted data, or -1 if that file failed.
+ * Setting up the key once for files that share it saves time per file compared to mlle_cr_decrypt.
+ *
+ * Returns the number of files that failed, or -1 on an error in the arguments.
+ */
+int mlle_cr_decrypt_batch(mlle_cr_context* context,
+                          size_t n,
+                          const char** relpaths,
+                          char** ins,
+                          const size_t* in_lens,
+                          char** outs,
+                          int* results);
+
+/*
+ * Decrypt the data in buffer in place, where len is the length of the data, laid out as for mlle_cr_decrypt.
+ * On success *out is set to point to the decrypted data, which starts at a small offset into buffer.
+ * The contents of buffer are undefined after a failure.
+ *
+ * Returns the length of the decrypted data, or -1 on an error.
+ */
+int mlle_cr_decrypt_inplace(mlle_cr_context* context,
+                            const char* relpath,
+                            char* buffer,
+                            size_t len,
+                            char** out);
+
+/*
+ * Length of the header of data in the chunked format (MLLE_CR_FORMAT_GCM_CHUNKED),
+ * which is followed by the first chunk.
+ */
+#define MLLE_CR_CHUNK_HEADER_LEN (24)
+
+/*
+ * Get the chunk layout of encrypted data, for decrypting it a chunk at a time with mlle_cr_decrypt_chunk.
+ *  header - the first header_len bytes of the data, at least MLLE_CR_CHUNK_HEADER_LEN for chunked data
+ *  in_len - the length of all the data
+ * On success *enc_chunk_len is set to the length of each encrypted chunk but the last one, which may be shorter,
+ * and *chunk_count to the number of chunks. Chunk i starts at MLLE_CR_CHUNK_HEADER_LEN + i * *enc_chunk_len.
+ *
+ * Returns 1 for chunked data, 0 for data in a format that cannot be decrypted by chunks, or -1 on an error.
+ */
+int mlle_cr_chunk_info(const char* header,
+                       size_t header_len,
+                       size_t in_len,
+                       size_t* enc_chunk_len,
+                       size_t* chunk_count);
+
+/*
+ * Decrypt and verify chunk number index of chunked data, see mlle_cr_chunk_info.
+ *  header - the first MLLE_CR_CHUNK_HEADER_LEN bytes of the data
+ *  in_len - the length of all the data
+ *  chunk, chunk_len - the encrypted chunk
+ * The buffer pointed to by out must hold chunk_len bytes, and may be the same as chunk.
+ * Chunks can be decrypted in any order. For package.moc files, the key mask stored at the end is left out.
+ *
+ * Returns the length of the decrypted data, or -1 on an error.
+ */
+int mlle_cr_decrypt_chunk(mlle_cr_context* context,
+                          const char* relpath,
+                          const char* header,
+                          size_t in_len,
+                          size_t index,
+                          const char* chunk,
+                          size_t chunk_len,
+                          char* out);
+
 
 
 #ifdef __cplusplus
@@ -29,9 +29,28 @@ extern "C" {
 typedef struct mlle_cr_context mlle_cr_context;
 #endif
 
+/*
+ * Formats that mlle_cr_encrypt can write. mlle_cr_decrypt reads all of them.
+ *  MLLE_CR_FORMAT_CBC_HMAC - AES-256-CBC and HMAC-SHA256, readable by all LVEs. The default.
+ *  MLLE_CR_FORMAT_GCM - AES-256-GCM, with a header. Faster to decrypt, but needs an LVE built with this version.
+ *  MLLE_CR_FORMAT_GCM_CHUNKED - AES-256-GCM in separately authenticated chunks, see mlle_cr_decrypt_chunk.
+ */
+#define MLLE_CR_FORMAT_CBC_HMAC (1)
+#define MLLE_CR_FORMAT_GCM (2)
+#define MLLE_CR_FORMAT_GCM_CHUNKED (3)
+
+/*
+ * Select the format that mlle_cr_encrypt writes with this context.
+ *
+ * Returns zero if the format is not supported.
+ */
+int mlle_cr_set_format(mlle_cr_context* context, int format);
+
 /*
  * Read data from stream in until eof, encrypt it, and write IV, encrypted store_mask, data and HMAC (in that order) to stream out.
  * key_masc is a xor masc applied to the key (NULL for no masc)
+ * Threads may encrypt different files with the same context at the same time, as long as the package.mo
+ * of a directory is done before any other file in it or in its subdirectories.
  *
  * Returns zero on error.
  */
@@ -40,6 +59,27 @@ int mlle_cr_encrypt(mlle_cr_context* context,
                     FILE* in,
                     FILE* out);
 
+/*
+ * Get the exact length of the data that mlle_cr_encrypt_mem writes when encrypting in_len bytes
+ * for relpath in the format selected for the context.
+ */
+size_t mlle_cr_encrypt_mem_size(mlle_cr_context* context,
+                                const char* relpath,
+                                size_t in_len);
+
+/*
+ * Encrypt the in_len bytes pointed to by in, and write the same data as mlle_cr_encrypt to the buffer pointed to by out.
+ * out_cap is the size of the buffer, which must be at least mlle_cr_encrypt_mem_size(context, relpath, in_len) bytes.
+ *
+ * Returns the length of the encrypted data, or zero on error.
+ */
+size_t mlle_cr_encrypt_mem(mlle_cr_context* context,
+                           const char* relpath,
+                           const char* in,
+                           size_t in_len,
+                           char* out,
+                           size_t out_cap);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,145 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+// Disable "deprecated" warning.
+#ifdef WIN32
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include "obfuscate_utils.h"
+#include "mlle_portability.h"
+
+#ifdef INCLUDE_OPENSSL_APPLINK
+#ifndef __INCLUDE_OPENSSL_APPLINK
+#define __INCLUDE_OPENSSL_APPLINK
+#include <openssl/applink.c>
+#endif /* __INCLUDE_OPENSSL_APPLINK */
+#endif /* INCLUDE_OPENSSL_APPLINK */
+
+#define FINGERPRINT_LEN 32
+
+static int compare_fingerprints(const void *a, const void *b)
+{
+    return memcmp(a, b, FINGERPRINT_LEN);
+}
+
+/***********************************************************************
+ * This program reads public keys (in pem files) and creates a header
+ * file with macros that produce a sorted table of the SHA-256
+ * fingerprints of their DER encoded SubjectPublicKeyInfo, for looking up
+ * a key with bsearch without having its PEM text or the keys themselves
+ * in the binary. The table is written by the obfuscator module, as a
+ * TOOL_PUBLIC key, so it is not stored in plain form.
+ *
+ * Usage:
+ *   fingerprint_keys <output file> <name of variable> <pem file>...
+ *
+ * Example:
+ *   % fingerprint_keys public_key_tool_fingerprints.h PUBLIC_KEY_TOOL a.pem b.pem
+ *
+ * The example above will generate public_key_tool_fingerprints.h with
+ *   PUBLIC_KEY_TOOL_FINGERPRINT_LEN (32)
+ *   PUBLIC_KEY_TOOL_FINGERPRINT_NUM (number of distinct keys)
+ * and macros used as for the keys made by obfuscate:
+ *   DECLARE_PUBLIC_KEY_TOOL_FINGERPRINTS();
+ *   INITIALIZE_PUBLIC_KEY_TOOL_FINGERPRINTS();
+ *   <use the NUM * LEN bytes in PUBLIC_KEY_TOOL_FINGERPRINTS>
+ *   CLEAR_PUBLIC_KEY_TOOL_FINGERPRINTS();
+ *
+ * The generated h-file does not include any ifndef/define construct -
+ * include it in one c-file only.
+ **********************************************************************/
+int main(int argc, char **argv)
+{
+    unsigned char *fingerprints = NULL;
+    unsigned char *der = NULL;
+    EVP_PKEY *key = NULL;
+    FILE *in = NULL;
+    FILE *out = NULL;
+    char *name = NULL;
+    char buffer_name[256];
+    int count = 0;
+    int der_len = 0;
+    int i = 0;
+    int j = 0;
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: fingerprint_keys <output file> <name of variable> <pem file>...\n");
+        return EXIT_FAILURE;
+    }
+    name = argv[2];
+    snprintf(buffer_name, sizeof(buffer_name), "%s_FINGERPRINTS", name);
+
+    fingerprints = (unsigned char*) malloc((size_t) (argc - 3) * FINGERPRINT_LEN);
+    if (fingerprints == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for (i = 3; i < argc; i++) {
+        in = open_or_exit(argv[i], "rb");
+        key = PEM_read_PUBKEY(in, NULL, NULL, NULL);
+        fclose(in);
+        if (key == NULL) {
+            fprintf(stderr, "Could not read a public key from '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        der = NULL;
+        der_len = i2d_PUBKEY(key, &der);
+        EVP_PKEY_free(key);
+        if (der_len <= 0 || !EVP_Digest(der, der_len, fingerprints + count * FINGERPRINT_LEN, NULL,
+                                        EVP_sha256(), NULL)) {
+            fprintf(stderr, "Could not fingerprint the public key in '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        OPENSSL_free(der);
+        count++;
+    }
+
+    /* Sort for bsearch, and drop keys that are listed twice. */
+    qsort(fingerprints, count, FINGERPRINT_LEN, compare_fingerprints);
+    for (i = 1, j = 1; i < count; i++) {
+        if (memcmp(fingerprints + i * FINGERPRINT_LEN, fingerprints + (j - 1) * FINGERPRINT_LEN,
+                   FINGERPRINT_LEN) != 0) {
+            memmove(fingerprints + j * FINGERPRINT_LEN, fingerprints + i * FINGERPRINT_LEN, FINGERPRINT_LEN);
+            j++;
+        }
+    }
+    count = j;
+
+    /* The table goes through the obfuscator module, as the keys themselves did. */
+    out = open_or_exit(argv[1], "wb");
+    fprintf(out, "#define %s_FINGERPRINT_LEN (%d)\n", name, FINGERPRINT_LEN);
+    fprintf(out, "#define %s_FINGERPRINT_NUM (%d)\n", name, count);
+    fprintf(out, "#define DECLARE_%s_FINGERPRINTS() unsigned char %s_FINGERPRINTS[%d]\n",
+            name, name, count * FINGERPRINT_LEN);
+    fprintf(out, "#define INITIALIZE_%s_FINGERPRINTS() do { ", name);
+    write_initialize_key_macro_body(out, TOOL_PUBLIC, buffer_name, fingerprints,
+                                    (size_t) count * FINGERPRINT_LEN);
+    fprintf(out, "} while (0)\n");
+    fprintf(out, "#define CLEAR_%s_FINGERPRINTS() memset(%s_FINGERPRINTS, 0, %d)\n",
+            name, name, count * FINGERPRINT_LEN);
+    write_header_extra(out, TOOL_PUBLIC);
+    fclose(out);
+
+    free(fingerprints);
+    return 0;
+}
@@ -51,6 +51,8 @@ FILE* open_or_exit(const char* fname, const char* mode);
  * Usage: 
  *   obfuscate <output file> <input pem file> <name of variable> <type of key>
  *  where <type of key> can be: TOOL_PUBLIC, TOOL_PRIVATE, or LVE_PRIVATE
+ * The build does not use TOOL_PUBLIC here, the trusted tool keys are
+ * written as a table of fingerprints by fingerprint_keys.
  *
  * Example: 
  *   % obfuscate private_key_tool.h private_key.pem PRIVATE_KEY_TOOL TOOL_PRIVATE
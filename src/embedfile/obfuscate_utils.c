@@ -56,6 +56,63 @@ FILE* open_or_exit(const char* fname, const char* mode)
 #define SIZE_T_FORMAT "%zu"
 #endif
 
+/* Bytes per line of tables written by write_table_decode_body. */
+#define TABLE_BYTES_PER_LINE 16
+
+/****************************************************
+ * Write a byte table for a macro body, continuing
+ * the macro on a new line every TABLE_BYTES_PER_LINE
+ * bytes.
+ ***************************************************/
+static void write_macro_table(FILE* out, const char* table_name, const unsigned char* data, size_t len)
+{
+    size_t i = 0;
+
+    fprintf(out, "static const unsigned char %s[" SIZE_T_FORMAT "] = {", table_name, len);
+    for (i = 0; i < len; i++) {
+        if (i % TABLE_BYTES_PER_LINE == 0)
+            fprintf(out, " \\\n    ");
+        fprintf(out, "0x%02x,", (unsigned int) data[i]);
+    }
+    fprintf(out, " }; \\\n");
+}
+
+void write_table_decode_body(FILE* out,
+                             char* buffer_name,
+                             const unsigned char* data,
+                             size_t data_len,
+                             const unsigned char* keystream,
+                             size_t keystream_len)
+{
+    char table_name[256];
+    char stream_name[256];
+    unsigned char *masked = NULL;
+    size_t i = 0;
+
+    masked = (unsigned char*) malloc(data_len > 0 ? data_len : 1);
+    if (masked == NULL) {
+        fprintf(stderr, "Could not allocate " SIZE_T_FORMAT " bytes\n", data_len);
+        exit(1);
+    }
+    for (i = 0; i < data_len; i++) {
+        masked[i] = data[i] ^ keystream[i & (keystream_len - 1)];
+    }
+    snprintf(table_name, sizeof(table_name), "%s_table", buffer_name);
+    snprintf(stream_name, sizeof(stream_name), "%s_stream", buffer_name);
+
+    /* Declarations first, the body starts a block. */
+    write_macro_table(out, table_name, masked, data_len);
+    write_macro_table(out, stream_name, keystream, keystream_len);
+    fprintf(out, "size_t %s_i; \\\n", buffer_name);
+    fprintf(out, "for (%s_i = 0; %s_i < " SIZE_T_FORMAT "; %s_i++) { \\\n",
+            buffer_name, buffer_name, data_len, buffer_name);
+    fprintf(out, "    %s[%s_i] = (unsigned char) (%s[%s_i] ^ %s[%s_i & " SIZE_T_FORMAT "]); \\\n} ",
+            buffer_name, buffer_name, table_name, buffer_name, stream_name, buffer_name, keystream_len - 1);
+
+    memset(masked, 0, data_len);
+    free(masked);
+}
+
 /****************************************************
  * Create a h-file with macros for accessing the key.
  *
@@ -40,6 +40,45 @@ extern "C" {
  */
 #define MLLE_CR_KEY_LENGTH (32)
 
+/*
+ * Encrypted file formats, see MLLE_CR_FORMAT_* in mlle_cr_encrypt.h.
+ *
+ * Format 1 has no header. It is the IV, the AES-256-CBC encrypted data
+ * and an HMAC-SHA256 of IV + plaintext.
+ *
+ * Later formats start with a header of MLLE_CR_HEADER_LENGTH bytes: the
+ * MLLE_CR_MAGIC bytes, the format number and three reserved zero bytes.
+ * Format 2 continues with a nonce, the AES-256-GCM encrypted data and the
+ * GCM tag. The header is authenticated as additional data.
+ *
+ * Format 3 splits the data into chunks that are encrypted with AES-256-GCM
+ * one by one, so that a chunk can be decrypted and verified without reading
+ * the rest of the file. The header is followed by the chunk length (the
+ * plaintext bytes in each chunk but the last, 4 bytes little endian) and a
+ * random nonce prefix, MLLE_CR_CHUNKED_HEADER_LENGTH bytes in all. Then
+ * come the chunks, each the encrypted data followed by its tag. All chunks
+ * but the last are full, and the last one may be empty. The nonce of chunk
+ * i is the nonce prefix followed by i as 4 bytes big endian, and the
+ * additional data is the MLLE_CR_CHUNKED_HEADER_LENGTH bytes of header
+ * followed by 1 for the last chunk and 0 for the others. So chunk i starts
+ * at MLLE_CR_CHUNKED_HEADER_LENGTH + i * (chunk length + tag length), and
+ * reordered, truncated or extended files fail to verify.
+ */
+#define MLLE_CR_MAGIC "\x89MOC\r\n\x1a\n"
+#define MLLE_CR_MAGIC_LENGTH (8)
+#define MLLE_CR_HEADER_LENGTH (12)
+
+#define MLLE_CR_GCM_CIPHER (EVP_aes_256_gcm())
+#define MLLE_CR_GCM_NONCE_LENGTH (12)
+#define MLLE_CR_GCM_TAG_LENGTH (16)
+
+#define MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH (8)
+#define MLLE_CR_CHUNKED_HEADER_LENGTH (MLLE_CR_HEADER_LENGTH + 4 + MLLE_CR_CHUNK_NONCE_PREFIX_LENGTH)
+/* Chunk length written by mlle_cr_encrypt. */
+#define MLLE_CR_CHUNK_LENGTH (64 * 1024)
+/* Largest chunk length accepted when decrypting. */
+#define MLLE_CR_CHUNK_LENGTH_MAX (16 * 1024 * 1024)
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,313 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+/*
+ * Verify all encrypted (.moc) files of a library without writing any
+ * plaintext, on several threads. Each thread has a decryptor context of
+ * its own, and takes the next file from a shared list.
+ *
+ * Usage: verify_library [-j <threads>] <library directory>
+ *
+ * Prints each file that fails, and a summary with the aggregate throughput.
+ * Returns 0 if all files are intact, 1 if any failed or if there are no .moc files.
+ */
+
+/* libcrypto-compat.h must be first */
+#include "libcrypto-compat.h"
+
+#define _XOPEN_SOURCE 700
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+/* mlle_portability.h must be first of the mlle headers */
+#include "mlle_portability.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include <openssl/conf.h>
+#include <openssl/evp.h>
+#include <openssl/err.h>
+#include "mlle_cr_decrypt.h"
+#include "mlle_error.h"
+#include "mlle_io.h"
+#include "mlle_stats.h"
+#include "mlle_thread.h"
+
+#ifdef INCLUDE_OPENSSL_APPLINK
+#ifndef __INCLUDE_OPENSSL_APPLINK
+#define __INCLUDE_OPENSSL_APPLINK
+#include <openssl/applink.c>
+#endif /* __INCLUDE_OPENSSL_APPLINK */
+#endif /* INCLUDE_OPENSSL_APPLINK */
+
+#define MAX_THREADS (64)
+#define PATH_LEN (4096)
+
+struct file_list {
+    char **paths;   /* relative to the library directory, with / as separator */
+    size_t count;
+    size_t cap;
+};
+
+struct verify_state {
+    const char *libdir;
+    struct file_list *files;
+    struct mlle_mutex *mutex;
+    size_t next;                /* next file to verify, protected by mutex */
+    size_t failed;              /* protected by mutex */
+    unsigned long long bytes;   /* protected by mutex */
+};
+
+static int add_file(struct file_list *files, const char *rel)
+{
+    if (files->count == files->cap) {
+        size_t cap = files->cap ? 2 * files->cap : 256;
+        char **paths = realloc(files->paths, cap * sizeof(*paths));
+        if (paths == NULL) {
+            return 0;
+        }
+        files->paths = paths;
+        files->cap = cap;
+    }
+    files->paths[files->count] = strdup(rel);
+    return files->paths[files->count++] != NULL;
+}
+
+static int is_moc(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 4 && strcasecmp(name + len - 4, ".moc") == 0;
+}
+
+/*
+ * Add the .moc files in directory rel of the library, and its subdirectories,
+ * to files. rel is "" for the top level. Returns 1 on success and 0 on failure.
+ */
+static int find_files(const char *libdir, const char *rel, struct file_list *files)
+{
+    char path[PATH_LEN];
+    char child[PATH_LEN];
+    int ok = 1;
+#ifdef _WIN32
+    WIN32_FIND_DATA data;
+    HANDLE find;
+
+    if (snprintf(path, sizeof(path), "%s/%s*", libdir, rel) >= (int) sizeof(path)) {
+        fprintf(stderr, "Path too long: %s/%s\n", libdir, rel);
+        return 0;
+    }
+    find = FindFirstFile(path, &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Could not open directory %s/%s\n", libdir, rel);
+        return 0;
+    }
+    do {
+        const char *name = data.cFileName;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+        /* With room for the / added for subdirectories. */
+        if (snprintf(child, sizeof(child) - 1, "%s%s", rel, name) >= (int) sizeof(child) - 1) {
+            fprintf(stderr, "Path too long: %s/%s%s\n", libdir, rel, name);
+            ok = 0;
+            break;
+        }
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            strcat(child, "/");
+            ok = find_files(libdir, child, files);
+        } else if (is_moc(name)) {
+            ok = add_file(files, child);
+        }
+    } while (ok && FindNextFile(find, &data));
+    FindClose(find);
+#else
+    DIR *dir = NULL;
+    struct dirent *entry = NULL;
+    struct stat info;
+
+    if (snprintf(path, sizeof(path), "%s/%s", libdir, rel) >= (int) sizeof(path)) {
+        fprintf(stderr, "Path too long: %s/%s\n", libdir, rel);
+        return 0;
+    }
+    dir = opendir(path);
+    if (dir == NULL) {
+        fprintf(stderr, "Could not open directory %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    while (ok && (entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+        /* With room for the / added for subdirectories. */
+        if (snprintf(child, sizeof(child) - 1, "%s%s", rel, name) >= (int) sizeof(child) - 1
+            || snprintf(path, sizeof(path), "%s/%s", libdir, child) >= (int) sizeof(path)) {
+            fprintf(stderr, "Path too long: %s/%s%s\n", libdir, rel, name);
+            ok = 0;
+            break;
+        }
+        if (stat(path, &info) != 0) {
+            continue;
+        }
+        if (S_ISDIR(info.st_mode)) {
+            strcat(child, "/");
+            ok = find_files(libdir, child, files);
+        } else if (is_moc(name)) {
+            ok = add_file(files, child);
+        }
+    }
+    closedir(dir);
+#endif
+    return ok;
+}
+
+static void verify_worker(void *arg)
+{
+    struct verify_state *state = arg;
+    mlle_cr_context *context = mlle_cr_create(state->libdir);
+    char path[PATH_LEN];
+    struct mlle_error *error = NULL;
+    char *buffer = NULL;
+    const char *rel = NULL;
+    const char *reason = NULL;
+    size_t size = 0;
+    size_t i = 0;
+    int ok = 0;
+
+    for (;;) {
+        mlle_mutex_lock(state->mutex);
+        i = state->next++;
+        mlle_mutex_unlock(state->mutex);
+        if (i >= state->files->count) {
+            break;
+        }
+        rel = state->files->paths[i];
+
+        buffer = NULL;
+        reason = "corrupt or wrong key";
+        if (snprintf(path, sizeof(path), "%s/%s", state->libdir, rel) >= (int) sizeof(path)) {
+            reason = "path too long";
+        } else {
+            buffer = mlle_io_read_file(path, &size, &error);
+        }
+        ok = context != NULL && buffer != NULL && mlle_cr_verify(context, rel, buffer, size) >= 0;
+
+        mlle_mutex_lock(state->mutex);
+        if (ok) {
+            state->bytes += size;
+        } else {
+            state->failed++;
+            fprintf(stderr, "FAILED %s: %s\n", rel,
+                    error ? mlle_error_get_message(error) : reason);
+        }
+        mlle_mutex_unlock(state->mutex);
+        free(buffer);
+        mlle_error_free(&error);
+    }
+    mlle_cr_free(context);
+}
+
+int main(int argc, char **argv)
+{
+    struct file_list files = { 0 };
+    struct verify_state state = { 0 };
+    struct mlle_thread *threads[MAX_THREADS] = { 0 };
+    int nthreads = mlle_thread_cpu_count();
+    const char *libdir = NULL;
+    mlle_stats_ns start = 0;
+    double seconds = 0.0;
+    size_t i = 0;
+    int t = 0;
+    int res = 1;
+
+    for (t = 1; t < argc; t++) {
+        if (strcmp(argv[t], "-j") == 0 && t + 1 < argc) {
+            nthreads = atoi(argv[++t]);
+        } else if (libdir == NULL) {
+            libdir = argv[t];
+        } else {
+            libdir = NULL;
+            break;
+        }
+    }
+    if (libdir == NULL || nthreads < 1) {
+        fprintf(stderr, "Usage: %s [-j <threads>] <library directory>\n"
+                "Verifies all .moc files of an encrypted library, without writing plaintext.\n", argv[0]);
+        return 1;
+    }
+    if (nthreads > MAX_THREADS) {
+        nthreads = MAX_THREADS;
+    }
+
+    /* OpenSSL initialization stuff. */
+    ERR_load_crypto_strings();
+    OpenSSL_add_all_algorithms();
+    OPENSSL_init_crypto(OPENSSL_INIT_LOAD_CONFIG, NULL);
+
+    if (!find_files(libdir, "", &files)) {
+        goto cleanup;
+    }
+    /* A plaintext library or the wrong directory has nothing to verify, which is not a pass. */
+    if (files.count == 0) {
+        fprintf(stderr, "No .moc files found in %s\n", libdir);
+        goto cleanup;
+    }
+    state.libdir = libdir;
+    state.files = &files;
+    state.mutex = mlle_mutex_new();
+    if (state.mutex == NULL) {
+        fprintf(stderr, "Could not create mutex\n");
+        goto cleanup;
+    }
+    if ((size_t) nthreads > files.count) {
+        nthreads = files.count > 0 ? (int) files.count : 1;
+    }
+
+    /* The main thread is one of the workers. */
+    start = mlle_stats_now();
+    for (t = 1; t < nthreads; t++) {
+        threads[t] = mlle_thread_start(verify_worker, &state);
+    }
+    verify_worker(&state);
+    for (t = 1; t < nthreads; t++) {
+        mlle_thread_join(threads[t]);
+    }
+    seconds = (double) (mlle_stats_now() - start) / 1e9;
+
+    printf("Verified %lu files, %llu bytes, with %d threads in %.3f s (%.1f MB/s). %lu failed.\n",
+           (unsigned long) files.count, state.bytes, nthreads, seconds,
+           seconds > 0 ? (double) state.bytes / (1024.0 * 1024.0) / seconds : 0.0,
+           (unsigned long) state.failed);
+    res = state.failed > 0;
+
+cleanup:
+    mlle_mutex_free(state.mutex);
+    for (i = 0; i < files.count; i++) {
+        free(files.paths[i]);
+    }
+    free(files.paths);
+
+    /* OpenSSL cleanup stuff. */
+    EVP_cleanup();
+    CRYPTO_cleanup_all_ex_data();
+    ERR_free_strings();
+
+    return res;
+}
@@ -0,0 +1,129 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+/*
+ * Asynchronous checkout for license managers that only implement the
+ * blocking mlle_license_checkout_feature(). The checkout is run in a worker
+ * thread. If no thread can be started, the checkout is done synchronously
+ * in mlle_license_checkout_feature_start() instead.
+ *
+ * License managers with a native asynchronous API configure with
+ * -DLICENSE_MANAGER_NATIVE_ASYNC_CHECKOUT=ON and provide the functions
+ * themselves.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* mlle_portability.h must be first */
+#include "mlle_portability.h"
+
+#include "mlle_error.h"
+#include "mlle_license_manager.h"
+#include "mlle_thread.h"
+
+struct mlle_license_checkout {
+    struct mlle_license *mlic;
+    struct mlle_thread *thread;
+    struct mlle_mutex *lock;
+    /* Protected by lock. */
+    int done;
+    int result;
+    struct mlle_error *error;
+    size_t feature_length;
+    /* NUL terminated copy, the caller's buffer may be gone by now. */
+    char feature[1];
+};
+
+static void
+mlle_license_checkout_run(void *arg)
+{
+    struct mlle_license_checkout *checkout = arg;
+    struct mlle_error *error = NULL;
+    int result = 0;
+
+    result = mlle_license_checkout_feature(checkout->mlic,
+            checkout->feature_length, checkout->feature, &error);
+
+    mlle_mutex_lock(checkout->lock);
+    checkout->result = result;
+    checkout->error = error;
+    checkout->done = 1;
+    mlle_mutex_unlock(checkout->lock);
+}
+
+struct mlle_license_checkout *
+mlle_license_checkout_feature_start(struct mlle_license *mlic,
+                                    size_t feature_length,
+                                    const char *feature,
+                                    struct mlle_error **error)
+{
+    struct mlle_license_checkout *checkout = NULL;
+
+    checkout = calloc(1, sizeof(*checkout) + feature_length);
+    if (checkout == NULL) {
+        goto error;
+    }
+    checkout->lock = mlle_mutex_new();
+    if (checkout->lock == NULL) {
+        goto error;
+    }
+    checkout->mlic = mlic;
+    checkout->feature_length = feature_length;
+    memcpy(checkout->feature, feature, feature_length);
+    checkout->feature[feature_length] = '\0';
+
+    checkout->thread = mlle_thread_start(mlle_license_checkout_run, checkout);
+    if (checkout->thread == NULL) {
+        mlle_license_checkout_run(checkout);
+    }
+
+    return checkout;
+
+error:
+    free(checkout);
+    mlle_error_set(error, LICENSE_DOMAIN, LICENSE_ERROR_INTERNAL,
+                   "Out of memory when starting license checkout.");
+    return NULL;
+}
+
+int
+mlle_license_checkout_feature_poll(struct mlle_license_checkout *checkout)
+{
+    int done = 0;
+
+    mlle_mutex_lock(checkout->lock);
+    done = checkout->done;
+    mlle_mutex_unlock(checkout->lock);
+
+    return done;
+}
+
+int
+mlle_license_checkout_feature_wait(struct mlle_license_checkout *checkout,
+                                   struct mlle_error **error)
+{
+    int result = 0;
+
+    mlle_thread_join(checkout->thread);
+
+    result = checkout->result;
+    if (checkout->error != NULL) {
+        mlle_error_propagate(error, checkout->error);
+    }
+
+    mlle_mutex_free(checkout->lock);
+    free(checkout);
+
+    return result;
+}
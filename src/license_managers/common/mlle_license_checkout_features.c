@@ -0,0 +1,50 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+/*
+ * Batch checkout for license managers that can only check out one feature
+ * at a time. License managers that can do a single server transaction
+ * configure with -DLICENSE_MANAGER_NATIVE_BATCH_CHECKOUT=ON and provide
+ * mlle_license_checkout_features() themselves.
+ */
+
+#include <stddef.h>
+
+/* mlle_portability.h must be first */
+#include "mlle_portability.h"
+
+#include "mlle_error.h"
+#include "mlle_license_manager.h"
+
+int
+mlle_license_checkout_features(struct mlle_license *mlic,
+                               size_t nfeatures,
+                               const size_t *feature_lengths,
+                               const char * const *features,
+                               int *granted,
+                               struct mlle_error **error)
+{
+    size_t i = 0;
+
+    (void) error;
+
+    for (i = 0; i < nfeatures; i++) {
+        struct mlle_error *feature_error = NULL;
+
+        granted[i] = mlle_license_checkout_feature(mlic, feature_lengths[i],
+                features[i], &feature_error);
+        /* A denied feature is an answer, not an error. */
+        mlle_error_free(&feature_error);
+    }
+
+    return MLLE_LIC_SUCCESS;
+}
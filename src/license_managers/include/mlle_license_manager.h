@@ -52,6 +52,69 @@ mlle_license_checkout_feature(struct mlle_license *mlic,
                               const char *feature,
                               struct mlle_error **error);
 
+/*
+ * Check out several features at once, e.g. in a single license server
+ * transaction. granted[i] is set to 1 if features[i] was checked out and 0
+ * if it was denied; feature names are NUL terminated as well.
+ * Returns MLLE_LIC_FAILURE (and sets error) only if no answer at all could
+ * be given. License managers without a batch API get a default
+ * implementation calling mlle_license_checkout_feature() for each feature,
+ * see license_managers/common/mlle_license_checkout_features.c.
+ */
+int
+mlle_license_checkout_features(struct mlle_license *mlic,
+                               size_t nfeatures,
+                               const size_t *feature_lengths,
+                               const char * const *features,
+                               int *granted,
+                               struct mlle_error **error);
+
+/*
+ * Asynchronous checkout.
+ *
+ * A checkout against a license server can take seconds. The LVE starts the
+ * checkout, does other work, and only waits for the result when it is
+ * actually needed:
+ *
+ *   checkout = mlle_license_checkout_feature_start(mlic, len, feature, &error);
+ *   ...
+ *   if (mlle_license_checkout_feature_poll(checkout)) { ...result is ready... }
+ *   ...
+ *   success = mlle_license_checkout_feature_wait(checkout, &error);
+ *
+ * No other mlle_license_* function may be called on mlic between start and
+ * wait. License managers that cannot do this natively get an implementation
+ * based on a worker thread calling mlle_license_checkout_feature(), see
+ * license_managers/common/mlle_license_checkout_async.c.
+ */
+struct mlle_license_checkout;
+
+/*
+ * Start checking out a feature. Returns NULL (and sets error) only if the
+ * checkout could not be started at all.
+ */
+struct mlle_license_checkout *
+mlle_license_checkout_feature_start(struct mlle_license *mlic,
+                                    size_t feature_length,
+                                    const char *feature,
+                                    struct mlle_error **error);
+
+/*
+ * Returns 1 if the checkout has finished, 0 if it is still in progress.
+ * Never blocks.
+ */
+int
+mlle_license_checkout_feature_poll(struct mlle_license_checkout *checkout);
+
+/*
+ * Wait for the checkout to finish and release the checkout handle.
+ * Returns MLLE_LIC_SUCCESS or MLLE_LIC_FAILURE (and sets error), just as
+ * mlle_license_checkout_feature().
+ */
+int
+mlle_license_checkout_feature_wait(struct mlle_license_checkout *checkout,
+                                   struct mlle_error **error);
+
 int
 mlle_license_checkin_feature(struct mlle_license *mlic,
                              size_t feature_length,
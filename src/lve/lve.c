@@ -216,7 +216,8 @@ int main(int argc, char **argv)
 {
     int result = EXIT_FAILURE;
     struct mlle_lve_ctx lve_ctx = {stdin, stdout, NULL, NULL, 0,
-                                   0,     0,      NULL, NULL, NULL};
+                                   0,     0,      NULL, NULL, NULL,
+                                   NULL,  NULL,   0,    0};
 
     char *checkout_feature = NULL;
     size_t checkout_feature_sz = 0;
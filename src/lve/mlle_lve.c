@@ -35,6 +35,7 @@
 #include "mlle_lve.h"
 
 #include "mlle_types.h"
+#include "mlle_trace.h"
 #include "openssl/err.h"
 #include "mlle_portability.h"
 #include <openssl/rsa.h>
@@ -68,6 +69,9 @@ mlle_lve_handle_command(struct mlle_lve_ctx *lve_ctx,
     long tool_protocol_max_version = 0;
     enum mlle_lve_state next_state = MLLE_LVE_STATE_INVALID;
     const int is_in_checkout_feature_without_tool_mode = 0;
+    mlle_stats_ns start = mlle_stats_now();
+
+    mlle_stats_count(MLLE_STATS_BYTES_RECEIVED, buffer_len);
 
     // Get next state.
     next_state = mlle_next_state(current_state, command->id, error_msg, error_length);
@@ -76,6 +80,7 @@ mlle_lve_handle_command(struct mlle_lve_ctx *lve_ctx,
     if (next_state == MLLE_LVE_STATE_INVALID) {
         mlle_send_error(lve_ctx->ssl, MLLE_PROTOCOL_COMMAND_NOT_UNDERSTOOD_ERROR,
                 error_msg);
+        mlle_stats_command(command->id, start);
         return current_state;
     }
 
@@ -125,12 +130,16 @@ mlle_lve_handle_command(struct mlle_lve_ctx *lve_ctx,
     case MLLE_LVE_STATE_LICENSE:
         if (command->id == MLLE_PROTOCOL_FEATURE_CMD) {
             mlle_lve_feature(lve_ctx, command, is_in_checkout_feature_without_tool_mode);
+        } else if (command->id == MLLE_PROTOCOL_FEATURES_CMD) {
+            mlle_lve_features(lve_ctx, command);
         } else if (command->id == MLLE_PROTOCOL_RETURNFEATURE_CMD) {
             mlle_lve_returnfeature(lve_ctx, command);
         } else if (command->id == MLLE_PROTOCOL_LICENSE_CMD) {
             mlle_lve_license(lve_ctx, command);
         } else if (command->id == MLLE_PROTOCOL_RETURNLICENSE_CMD) {
             mlle_lve_returnlicense(lve_ctx, command);
+        } else if (command->id == MLLE_PROTOCOL_STATS_CMD) {
+            mlle_lve_stats(lve_ctx);
         } else {
             mlle_lve_file(lve_ctx, command);   // command->id == MLLE_PROTOCOL_FILECONT_CMD
         }
@@ -146,6 +155,9 @@ mlle_lve_handle_command(struct mlle_lve_ctx *lve_ctx,
         command->data = NULL;
     }
 
+    mlle_stats_command(command->id, start);
+    mlle_lve_stats_report(lve_ctx, 0);
+
     return next_state;
 }
 
@@ -170,9 +182,12 @@ int mlle_lve_receive(struct mlle_lve_ctx *lve_ctx)
     char *messageBuffer = NULL;
     char *tokenBuffer = NULL;
     FILE *fd = NULL;
+    mlle_stats_ns start = 0;
 
     // Validate tools public key to see if it's trusted or not.
+    start = mlle_stats_now();
     mlle_lve_validate_pubkey(lve_ctx);
+    mlle_stats_startup(MLLE_STATS_STARTUP_PUBKEY, start);
 
     // From the read we get a buffer and size of the buffer.
     bytesRead = ssl_read_message(lve_ctx->ssl, &messageBuffer, &errorCode);
@@ -237,6 +252,62 @@ int mlle_lve_receive(struct mlle_lve_ctx *lve_ctx)
 }
 
 
+/*************************************************
+ * Write statistics as JSON to the log, if it is open.
+ *
+ * Parameters:
+ *      lve_ctx - container for LVE information.
+ *      force - write even if the report interval
+ *              has not passed.
+ *************************************************/
+void mlle_lve_stats_report(struct mlle_lve_ctx *lve_ctx, int force)
+{
+    mlle_stats_ns now = 0;
+
+    if (mlle_log == NULL) {
+        return;
+    }
+    if (!force) {
+        if (lve_ctx->stats_report_interval == 0) {
+            return;
+        }
+        now = mlle_stats_now();
+        if (now - lve_ctx->stats_last_report < lve_ctx->stats_report_interval) {
+            return;
+        }
+        lve_ctx->stats_last_report = now;
+    }
+
+    fprintf(mlle_log, "LVE statistics: ");
+    mlle_stats_write_json(mlle_log);
+}
+
+
+/*************************************************
+ * Handles the command STATS. Replies with the
+ * current counters as "STATSCONT <LENGTH>LF<DATA>",
+ * DATA being lines of "<key>=<value>".
+ *
+ * Parameters:
+ *      lve_ctx - container for LVE information.
+ *************************************************/
+void mlle_lve_stats(struct mlle_lve_ctx *lve_ctx)
+{
+    size_t length = mlle_stats_format(NULL, 0);
+    char *buffer = malloc(length + 1);
+
+    if (buffer == NULL) {
+        mlle_send_error(lve_ctx->ssl, MLLE_PROTOCOL_OTHER_ERROR,
+                "Couldn't allocate memory");
+        return;
+    }
+    length = mlle_stats_format(buffer, length + 1);
+    mlle_send_length_form(lve_ctx->ssl, MLLE_PROTOCOL_STATSCONT_CMD,
+            length, buffer);
+    free(buffer);
+}
+
+
 /*************************************************
  * Shutdown LVE. Close connection to SSL.
  *
@@ -245,9 +316,14 @@ int mlle_lve_receive(struct mlle_lve_ctx *lve_ctx)
  *************************************************/
 void mlle_lve_shutdown(struct mlle_lve_ctx *lve_ctx)
 {
+    mlle_lve_stats_report(lve_ctx, 1);
+    mlle_trace_dump(mlle_log);
+
+    mlle_lve_global_license_wait(lve_ctx);
     if (lve_ctx->lic_mgr != NULL) {
         mlle_license_free(lve_ctx->lic_mgr);
     }
+    mlle_lve_feature_cache_free(lve_ctx);
 
     /*
      * TODO: this will try to free constant strings, but without it we might leak memory
@@ -266,6 +342,14 @@ void mlle_lve_shutdown(struct mlle_lve_ctx *lve_ctx)
 
 void mlle_lve_init(struct mlle_lve_ctx *lve_ctx)
 {
+    const char *interval = getenv("SEMLA_LVE_STATS_INTERVAL");
+
+    mlle_stats_enable();
+    if (interval != NULL) {
+        lve_ctx->stats_report_interval =
+            (mlle_stats_ns) strtoul(interval, NULL, 10) * 1000000000ULL;
+    }
+    lve_ctx->stats_last_report = mlle_stats_now();
 
 #ifdef _WIN32
     _setmode(_fileno(lve_ctx->in_stream), _O_BINARY);
@@ -30,6 +30,7 @@
 #include "mlle_ssl_lve.h"
 #include "mlle_utils.h"
 #include "mlle_cr_decrypt.h"
+#include "mlle_stats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -41,6 +42,9 @@ extern "C" {
 #define MIN_PROTOCOL_VERSION (1)
 #define MAX_PROTOCOL_VERSION (1)
 
+struct mlle_lve_feature_cache_entry;
+struct mlle_license_checkout;
+
 struct mlle_lve_ctx {
     FILE *in_stream;
     FILE *out_stream;
@@ -52,6 +56,13 @@ struct mlle_lve_ctx {
     char *tool_error_msg;
     struct mlle_license *lic_mgr;
     mlle_cr_context *cr_context;
+    /* Results of earlier FEATURE checkouts, see mlle_lve_feature.c */
+    struct mlle_lve_feature_cache_entry *feature_cache;
+    /* Global license checkout started by LIB and not yet waited for. */
+    struct mlle_license_checkout *global_checkout;
+    /* Write statistics to the log this often, 0 for only at shutdown. */
+    mlle_stats_ns stats_report_interval;
+    mlle_stats_ns stats_last_report;
 };
 
 
@@ -69,6 +80,10 @@ mlle_lve_handle_command(struct mlle_lve_ctx *lve_ctx,
 
 int mlle_lve_receive(struct mlle_lve_ctx *lve_ctx);
 
+void mlle_lve_stats(struct mlle_lve_ctx *lve_ctx);
+
+void mlle_lve_stats_report(struct mlle_lve_ctx *lve_ctx, int force);
+
 void mlle_lve_shutdown(struct mlle_lve_ctx *lve_ctx);
 
 #ifdef __cplusplus
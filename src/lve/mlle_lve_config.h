@@ -30,6 +30,24 @@ extern "C" {
 #define MLLE_GLOBAL_LICENSE_FEATURE <feature name>
 */
 
+/*
+ * Number of seconds the result of a granted FEATURE checkout is reused
+ * before the license manager is asked again. 0 disables caching of
+ * granted results.
+ */
+#ifndef MLLE_FEATURE_CACHE_TTL
+#define MLLE_FEATURE_CACHE_TTL (300)
+#endif
+
+/*
+ * Number of seconds the result of a denied FEATURE checkout is reused.
+ * Kept short so that a license that becomes available is noticed soon.
+ * 0 disables caching of denied results.
+ */
+#ifndef MLLE_FEATURE_NEGATIVE_CACHE_TTL
+#define MLLE_FEATURE_NEGATIVE_CACHE_TTL (10)
+#endif
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
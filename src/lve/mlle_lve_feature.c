@@ -16,8 +16,12 @@
 
 #define _XOPEN_SOURCE 700
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 /* libcrypto-compat.h must be first */
 #include "libcrypto-compat.h"
+#include <uthash.h>
 
 #include "mlle_lve.h"
 #include "mlle_protocol.h"
@@ -25,10 +29,173 @@
 #include "mlle_io.h"
 #include "mlle_license_manager.h"
 #include "mlle_lve_feature.h"
+#include "mlle_lve_config.h"
+
+/*
+ * Result of an earlier FEATURE checkout. Tools tend to ask for the same
+ * feature over and over again, and each request can mean a round trip to
+ * a license server, so the answer is reused until it expires. Entries are
+ * keyed on the feature name and live in lve_ctx->feature_cache.
+ */
+struct mlle_lve_feature_cache_entry {
+    UT_hash_handle hh;
+    int granted;
+    time_t expires;
+    /* Error message sent with NO, NULL for granted features. */
+    char *message;
+    size_t feature_len;
+    char feature[1];
+};
+
+static void
+mlle_lve_feature_cache_remove(struct mlle_lve_ctx *lve_ctx,
+                              struct mlle_lve_feature_cache_entry *entry)
+{
+    HASH_DEL(lve_ctx->feature_cache, entry);
+    free(entry->message);
+    free(entry);
+}
+
+/*
+ * Look up a non-expired result for the given feature.
+ * Returns the entry, or NULL if the license manager has to be asked.
+ */
+static struct mlle_lve_feature_cache_entry *
+mlle_lve_feature_cache_find(struct mlle_lve_ctx *lve_ctx,
+                            size_t feature_len, const char *feature)
+{
+    struct mlle_lve_feature_cache_entry *entry = NULL;
+
+    HASH_FIND(hh, lve_ctx->feature_cache, feature, feature_len, entry);
+    if (entry != NULL && entry->expires <= time(NULL)) {
+        mlle_lve_feature_cache_remove(lve_ctx, entry);
+        entry = NULL;
+    }
+
+    mlle_stats_count(entry == NULL ? MLLE_STATS_FEATURE_CACHE_MISSES
+                                   : MLLE_STATS_FEATURE_CACHE_HITS, 1);
+    if (mlle_log) {
+        if (entry == NULL) {
+            fprintf(mlle_log, "Feature cache miss: %s\n", feature);
+        } else {
+            fprintf(mlle_log, "Feature cache hit: %s (%s)\n", feature,
+                    entry->granted ? "granted" : "denied");
+        }
+    }
+
+    return entry;
+}
+
+/*
+ * Remember the result of a checkout. Failing to allocate an entry is not an
+ * error, the feature is simply checked out again next time.
+ */
+static void
+mlle_lve_feature_cache_store(struct mlle_lve_ctx *lve_ctx,
+                             size_t feature_len, const char *feature,
+                             int granted, const char *message)
+{
+    struct mlle_lve_feature_cache_entry *entry = NULL;
+    int ttl = granted ? MLLE_FEATURE_CACHE_TTL : MLLE_FEATURE_NEGATIVE_CACHE_TTL;
+
+    if (ttl <= 0) {
+        return;
+    }
+
+    entry = calloc(1, sizeof(*entry) + feature_len);
+    if (entry == NULL) {
+        return;
+    }
+    if (!granted && message != NULL) {
+        entry->message = strdup(message);
+        if (entry->message == NULL) {
+            free(entry);
+            return;
+        }
+    }
+    memcpy(entry->feature, feature, feature_len);
+    entry->feature_len = feature_len;
+    entry->granted = granted;
+    entry->expires = time(NULL) + ttl;
+
+    HASH_ADD(hh, lve_ctx->feature_cache, feature, feature_len, entry);
+}
+
+/*
+ * Forget any result for the given feature, so that the next FEATURE
+ * command goes to the license manager.
+ */
+static void
+mlle_lve_feature_cache_invalidate(struct mlle_lve_ctx *lve_ctx,
+                                  size_t feature_len, const char *feature)
+{
+    struct mlle_lve_feature_cache_entry *entry = NULL;
+
+    HASH_FIND(hh, lve_ctx->feature_cache, feature, feature_len, entry);
+    if (entry != NULL) {
+        mlle_lve_feature_cache_remove(lve_ctx, entry);
+    }
+}
+
+void
+mlle_lve_feature_cache_free(struct mlle_lve_ctx *lve_ctx)
+{
+    struct mlle_lve_feature_cache_entry *entry = NULL;
+    struct mlle_lve_feature_cache_entry *tmp = NULL;
+
+    HASH_ITER(hh, lve_ctx->feature_cache, entry, tmp) {
+        mlle_lve_feature_cache_remove(lve_ctx, entry);
+    }
+}
+
+/**********************************************************
+ * Wait for the global license checkout started by LIB, if any.
+ * On failure the tool is no longer approved and the error is
+ * reported for every following FILE command.
+ *
+ * Returns:
+ *      1 - no checkout pending, or it succeeded.
+ *      0 - the checkout failed.
+ *********************************************************/
+int
+mlle_lve_global_license_wait(struct mlle_lve_ctx *lve_ctx)
+{
+    struct mlle_error *error = NULL;
+    int success = 0;
+    mlle_stats_ns start = 0;
+
+    if (lve_ctx->global_checkout == NULL) {
+        return 1;
+    }
+
+    if (mlle_log) {
+        fprintf(mlle_log, "Global license checkout %s\n",
+                mlle_license_checkout_feature_poll(lve_ctx->global_checkout)
+                    ? "already finished" : "still running, waiting");
+    }
+    start = mlle_stats_now();
+    success = mlle_license_checkout_feature_wait(lve_ctx->global_checkout,
+            &error);
+    mlle_stats_phase(MLLE_STATS_PHASE_LICENSE, start);
+    lve_ctx->global_checkout = NULL;
+
+    if (!success) {
+        lve_ctx->tool_error_msg = strdup(error != NULL
+                ? mlle_error_get_message(error) : "License checkout failed.");
+        lve_ctx->tool_error_type = MLLE_PROTOCOL_LICENSE_ERROR;
+        lve_ctx->tool_approved = 0;
+        mlle_error_free(&error);
+    }
+
+    return success;
+}
 
 int
 mlle_lve_setup_licensing(struct mlle_lve_ctx *lve_ctx, struct mlle_error **error)
 {
+    /* The license manager must not be used while a checkout is running. */
+    mlle_lve_global_license_wait(lve_ctx);
+
     if (lve_ctx->lic_mgr == NULL) {
         lve_ctx->lic_mgr = mlle_license_new(lve_ctx->libpath, error);
     }
@@ -57,14 +224,34 @@ mlle_lve_feature(struct mlle_lve_ctx *lve_ctx,
                  const int is_in_checkout_feature_without_tool_mode)
 {
     struct mlle_error *error = NULL;
+    struct mlle_lve_feature_cache_entry *cached = NULL;
     int success = 0;
+    mlle_stats_ns start = 0;
+
+    cached = mlle_lve_feature_cache_find(lve_ctx, command->length,
+            command->data);
+    if (cached != NULL) {
+        if (is_in_checkout_feature_without_tool_mode) {
+            /* Nothing to send. */
+        } else if (cached->granted) {
+            mlle_send_simple_form(lve_ctx->ssl, MLLE_PROTOCOL_YES_CMD);
+        } else {
+            mlle_send_string(lve_ctx->ssl, MLLE_PROTOCOL_NO_CMD,
+                    cached->message ? cached->message : "");
+        }
+        return cached->granted;
+    }
 
     if (!mlle_lve_setup_licensing_check_error(lve_ctx)) {
         return 0;
     }
 
+    start = mlle_stats_now();
     success = mlle_license_checkout_feature(lve_ctx->lic_mgr, command->length,
             command->data, &error);
+    mlle_stats_phase(MLLE_STATS_PHASE_LICENSE, start);
+    mlle_lve_feature_cache_store(lve_ctx, command->length, command->data,
+            success, success ? NULL : mlle_error_get_message(error));
     if (success) {
         if (!is_in_checkout_feature_without_tool_mode) {
             mlle_send_simple_form(lve_ctx->ssl, MLLE_PROTOCOL_YES_CMD);
@@ -81,6 +268,143 @@ mlle_lve_feature(struct mlle_lve_ctx *lve_ctx,
     }
 }
 
+/**********************************************************
+ * Handles the command FEATURES, "FEATURES <LENGTH>LF<DATA>",
+ * where DATA is a list of feature names separated by LF.
+ * Features not answered by the cache are checked out with one
+ * call to the license manager.
+ *
+ * Replies "FEATURES <N>LF<VECTOR>", with one character per
+ * requested feature, in order: 'Y' if granted, 'N' if denied.
+ *
+ * Returns:
+ *      1 - a reply vector was sent.
+ *      0 - an error was sent.
+ *********************************************************/
+int
+mlle_lve_features(struct mlle_lve_ctx *lve_ctx,
+                  const struct mlle_command *command)
+{
+    struct mlle_error *error = NULL;
+    struct mlle_lve_feature_cache_entry *cached = NULL;
+    size_t nfeatures = 0;
+    size_t nmissing = 0;
+    size_t i = 0;
+    size_t start = 0;
+    char **features = NULL;
+    size_t *lengths = NULL;
+    const char **missing = NULL;
+    size_t *missing_lengths = NULL;
+    size_t *missing_index = NULL;
+    int *missing_granted = NULL;
+    char *reply = NULL;
+    const char *error_msg = NULL;
+    enum mlle_protocol_error_id error_code = MLLE_PROTOCOL_UNDEFINED_ERROR;
+
+    if (command->data == NULL || command->length == 0) {
+        error_code = MLLE_PROTOCOL_COMMAND_NOT_UNDERSTOOD_ERROR;
+        error_msg = "No features given.";
+        goto cleanup;
+    }
+
+    /* Split the list in place; a trailing LF is allowed. */
+    nfeatures = 1;
+    for (i = 0; i + 1 < command->length; i++) {
+        if (command->data[i] == '\n') {
+            nfeatures++;
+        }
+    }
+    features = calloc(nfeatures, sizeof(*features));
+    lengths = calloc(nfeatures, sizeof(*lengths));
+    missing = calloc(nfeatures, sizeof(*missing));
+    missing_lengths = calloc(nfeatures, sizeof(*missing_lengths));
+    missing_index = calloc(nfeatures, sizeof(*missing_index));
+    missing_granted = calloc(nfeatures, sizeof(*missing_granted));
+    reply = malloc(nfeatures);
+    if (features == NULL || lengths == NULL || missing == NULL
+        || missing_lengths == NULL || missing_index == NULL
+        || missing_granted == NULL || reply == NULL) {
+        error_code = MLLE_PROTOCOL_OTHER_ERROR;
+        error_msg = "Couldn't allocate memory";
+        goto cleanup;
+    }
+
+    nfeatures = 0;
+    for (i = 0; i <= command->length; i++) {
+        if (i == command->length || command->data[i] == '\n') {
+            if (i == command->length && start == i && nfeatures > 0) {
+                break; /* trailing LF */
+            }
+            if (start == i) {
+                error_code = MLLE_PROTOCOL_COMMAND_NOT_UNDERSTOOD_ERROR;
+                error_msg = "Empty feature name.";
+                goto cleanup;
+            }
+            command->data[i] = '\0';
+            features[nfeatures] = command->data + start;
+            lengths[nfeatures] = i - start;
+            nfeatures++;
+            start = i + 1;
+        }
+    }
+
+    for (i = 0; i < nfeatures; i++) {
+        cached = mlle_lve_feature_cache_find(lve_ctx, lengths[i], features[i]);
+        if (cached != NULL) {
+            reply[i] = cached->granted ? 'Y' : 'N';
+        } else {
+            missing[nmissing] = features[i];
+            missing_lengths[nmissing] = lengths[i];
+            missing_index[nmissing] = i;
+            nmissing++;
+        }
+    }
+
+    if (nmissing > 0) {
+        int success = mlle_lve_setup_licensing(lve_ctx, &error);
+
+        if (success) {
+            mlle_stats_ns start = mlle_stats_now();
+            success = mlle_license_checkout_features(lve_ctx->lic_mgr,
+                    nmissing, missing_lengths, missing, missing_granted, &error);
+            mlle_stats_phase(MLLE_STATS_PHASE_LICENSE, start);
+        }
+        if (!success) {
+            error_code = MLLE_PROTOCOL_LICENSE_ERROR;
+            error_msg = error != NULL ? mlle_error_get_message(error)
+                                      : "License checkout failed.";
+            goto cleanup;
+        }
+        for (i = 0; i < nmissing; i++) {
+            reply[missing_index[i]] = missing_granted[i] ? 'Y' : 'N';
+            /* The batch call gives no reason for a denial, and FEATURE
+             * must reply with one, so only grants are cached. */
+            if (missing_granted[i]) {
+                mlle_lve_feature_cache_store(lve_ctx, missing_lengths[i],
+                        missing[i], 1, NULL);
+            }
+        }
+    }
+
+    mlle_send_length_form(lve_ctx->ssl, MLLE_PROTOCOL_FEATURES_CMD,
+            nfeatures, reply);
+
+cleanup:
+    if (error_msg != NULL) {
+        mlle_send_error(lve_ctx->ssl, error_code, error_msg);
+    }
+    mlle_error_free(&error);
+    free(features);
+    free(lengths);
+    free(missing);
+    free(missing_lengths);
+    free(missing_index);
+    free(missing_granted);
+    free(reply);
+
+    return error_msg == NULL;
+}
+
 int
 mlle_lve_returnfeature(struct mlle_lve_ctx *lve_ctx,
                        const struct mlle_command *command)
@@ -92,6 +416,7 @@ mlle_lve_returnfeature(struct mlle_lve_ctx *lve_ctx,
         return 0;
     }
 
+    mlle_lve_feature_cache_invalidate(lve_ctx, command->length, command->data);
     success = mlle_license_checkin_feature(lve_ctx->lic_mgr, command->length,
             command->data, &error);
     if (success) {
@@ -31,10 +31,20 @@ mlle_lve_feature(struct mlle_lve_ctx *lve_ctx,
                  const struct mlle_command *command,
                  const int is_in_checkout_feature_without_tool_mode);
 
+int
+mlle_lve_features(struct mlle_lve_ctx *lve_ctx,
+                  const struct mlle_command *command);
+
 int
 mlle_lve_returnfeature(struct mlle_lve_ctx *lve_ctx,
                        const struct mlle_command *command);
 
+void
+mlle_lve_feature_cache_free(struct mlle_lve_ctx *lve_ctx);
+
+int
+mlle_lve_global_license_wait(struct mlle_lve_ctx *lve_ctx);
+
 int
 mlle_lve_setup_licensing(struct mlle_lve_ctx *lve_ctx, struct mlle_error **error);
 
@@ -23,6 +23,8 @@
 #include "mlle_io.h"
 #include "mlle_lve_file.h"
 #include "mlle_cr_decrypt.h"
+#include "mlle_lve_feature.h"
+#include "mlle_trace.h"
 
 int
 mlle_lve_file(struct mlle_lve_ctx *lve_ctx,
@@ -35,11 +37,14 @@ mlle_lve_file(struct mlle_lve_ctx *lve_ctx,
     char *error_msg = NULL;
     size_t file_size = 0;
     char *file_buffer = NULL;
-    char *file_out_buffer = NULL;
+    char *file_out_buffer = NULL; /* points into file_buffer */
     struct mlle_error *error = NULL;
     char *file_extension;
     int decrypted_size = 0;
+    mlle_stats_ns start = 0;
 
+    /* No file contents until the global license, if any, is checked out. */
+    mlle_lve_global_license_wait(lve_ctx);
     if (!lve_ctx->tool_approved) {
         error_code = lve_ctx->tool_error_type;
         error_msg = lve_ctx->tool_error_msg;
@@ -56,13 +61,20 @@ mlle_lve_file(struct mlle_lve_ctx *lve_ctx,
     }
     rel_file_path = command->data;
     snprintf(file_path, path_size, "%s/%s", lve_ctx->libpath, rel_file_path);
+    mlle_trace(MLLE_TRACE_FILE_REQUEST, mlle_trace_hash(rel_file_path),
+               (long long) command->length, 0);
 
+    start = mlle_stats_now();
     file_buffer = mlle_io_read_file(file_path, &file_size, &error);
+    mlle_stats_phase(MLLE_STATS_PHASE_FILE_READ, start);
     if (file_buffer == NULL) {
         error_code = MLLE_PROTOCOL_FILE_IO_ERROR;
         error_msg = mlle_error_get_message(error);
         goto CLEANUP;
     }
+    mlle_stats_count(MLLE_STATS_FILE_BYTES_READ, file_size);
+    mlle_trace(MLLE_TRACE_FILE_READ, mlle_trace_hash(rel_file_path),
+               (long long) file_size, 0);
     file_extension = strrchr(command->data, '.');
     if (file_extension != NULL)
         file_extension++;
@@ -71,18 +83,7 @@ mlle_lve_file(struct mlle_lve_ctx *lve_ctx,
     if (file_extension != NULL
         && strcasecmp(file_extension, MLLE_ENCRYPTED_MODELICA_FILE_EXTENSION) == 0)
     {
-
-        file_out_buffer = malloc(file_size + 1);
-        if (file_out_buffer == NULL) {
-            error_code = MLLE_PROTOCOL_OTHER_ERROR;
-            error_msg = malloc(100 + path_size);
-            if (error_msg != NULL) {
-                snprintf(error_msg, 100 + path_size, "Could not allocate memory to decrypt file %s.", file_path);
-            }
-            goto CLEANUP;
-        }
-
-        decrypted_size = mlle_cr_decrypt(lve_ctx->cr_context, rel_file_path, file_buffer, file_size, file_out_buffer);
+        decrypted_size = mlle_cr_decrypt_inplace(lve_ctx->cr_context, rel_file_path, file_buffer, file_size, &file_out_buffer);
         
         if (decrypted_size < 0) {
             error_code = MLLE_PROTOCOL_OTHER_ERROR;
@@ -93,6 +94,7 @@ mlle_lve_file(struct mlle_lve_ctx *lve_ctx,
             goto CLEANUP;
         }
         file_size = decrypted_size;
+        mlle_stats_count(MLLE_STATS_FILES_DECRYPTED, 1);
         /* Send file data. */
         mlle_send_length_form(lve_ctx->ssl, MLLE_PROTOCOL_FILECONT_CMD,
             file_size, file_out_buffer);
@@ -103,12 +105,16 @@ mlle_lve_file(struct mlle_lve_ctx *lve_ctx,
             file_size, file_buffer);
     }
 
+    mlle_stats_count(MLLE_STATS_FILES_SERVED, 1);
+    mlle_trace(MLLE_TRACE_FILE_SENT, mlle_trace_hash(rel_file_path),
+               (long long) file_size, 0);
 
 CLEANUP:
     free(file_buffer);
-    free(file_out_buffer);
     free(file_path);
     if (error_msg != NULL) {
+        mlle_trace(MLLE_TRACE_FILE_ERROR, mlle_trace_hash(command->data),
+                   error_code, 0);
         mlle_send_error(lve_ctx->ssl, error_code, error_msg);
     }
     if (error != NULL) {
@@ -33,10 +33,47 @@
 #include "mlle_lve_libpath.h"
 #include "mlle_protocol.h"
 
-#ifdef MLLE_GLOBAL_LICENSE_FEATURE
+#include "mlle_cr_decrypt.h"
 #include "mlle_license_manager.h"
 #include "mlle_lve_feature.h"
-#endif
+
+/*************************************************************
+ * Read and decrypt the top level package.moc, which stores its key mask
+ * in the decryption context. Every other file in the library depends on
+ * that mask, so this is work the first FILE request would do anyway.
+ * Failures are ignored here; they are reported when the file is requested.
+ *
+ * Parameters:
+ *      lve_ctx - structure containing the library path.
+ ************************************************************/
+static void prime_key_masks(struct mlle_lve_ctx *lve_ctx)
+{
+    char *file_path = NULL;
+    size_t path_size = 0;
+    char *file_buffer = NULL;
+    char *file_out_buffer = NULL;
+    size_t file_size = 0;
+    struct mlle_error *error = NULL;
+
+    path_size = lve_ctx->path_size + sizeof("/package.moc");
+    file_path = malloc(path_size);
+    if (file_path == NULL) {
+        goto cleanup;
+    }
+    snprintf(file_path, path_size, "%s/package.moc", lve_ctx->libpath);
+
+    file_buffer = mlle_io_read_file(file_path, &file_size, &error);
+    if (file_buffer == NULL) {
+        goto cleanup;
+    }
+    mlle_cr_decrypt_inplace(lve_ctx->cr_context, "package.moc", file_buffer,
+                            file_size, &file_out_buffer);
+
+cleanup:
+    free(file_path);
+    free(file_buffer);
+    mlle_error_free(&error);
+}
 
 /* Need both due to sneaky preprocessor behavior. */
 #define STR2(x) #x
@@ -90,7 +127,9 @@ int mlle_lve_libpath(struct mlle_lve_ctx *lve_ctx,
             "Failed to allocate memory for decryption context.";
         return 0;
     }
-    /* Check global licence, if defined. */
+    /* Check global licence, if defined. The checkout is started here and
+     * only waited for when a file is requested, see
+     * mlle_lve_global_license_wait(). */
 #ifdef MLLE_GLOBAL_LICENSE_FEATURE
     if (lve_ctx->tool_approved) {
         struct mlle_error *error = NULL;
@@ -98,9 +137,17 @@ int mlle_lve_libpath(struct mlle_lve_ctx *lve_ctx,
 
         success = mlle_lve_setup_licensing(lve_ctx, &error);
         if (success) {
-            success = mlle_license_checkout_feature(
+            lve_ctx->global_checkout = mlle_license_checkout_feature_start(
                 lve_ctx->lic_mgr, strlen(STR(MLLE_GLOBAL_LICENSE_FEATURE)),
                 STR(MLLE_GLOBAL_LICENSE_FEATURE), &error);
+            success = lve_ctx->global_checkout != NULL;
+        }
+        if (success && is_in_checkout_feature_without_tool_mode) {
+            /* Nothing to overlap with, just wait for the result. */
+            success = mlle_lve_global_license_wait(lve_ctx);
+            if (!success) {
+                return 0;
+            }
         }
         if (!success) {
             lve_ctx->tool_error_msg = strdup(mlle_error_get_message(error));
@@ -125,6 +172,11 @@ int mlle_lve_libpath(struct mlle_lve_ctx *lve_ctx,
         return 0;
     }
 
+    /* Use the time spent waiting for the license server. */
+    if (lve_ctx->global_checkout != NULL) {
+        prime_key_masks(lve_ctx);
+    }
+
     return 1;
 }
 
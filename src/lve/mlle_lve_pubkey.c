@@ -15,6 +15,7 @@
 */
 
 #define _XOPEN_SOURCE 700
+#include <stdlib.h>
 #include <string.h>
 /* libcrypto-compat.h must be first */
 #include "libcrypto-compat.h"
@@ -25,7 +26,7 @@
 #include "mlle_error.h"
 #include "mlle_io.h"
 #include "mlle_lve_pubkey.h"
-#include "public_key_tool.h"
+#include "public_key_tool_fingerprints.h"
 
 /**************************************************************
  * Validates the public key from a Tool (client) with public
@@ -54,10 +55,22 @@ void mlle_lve_validate_pubkey(struct mlle_lve_ctx *lve_ctx)
 
 }
 
+#if PUBLIC_KEY_TOOL_FINGERPRINT_LEN != MLLE_SSL_FINGERPRINT_LEN
+#error "Tool key fingerprints must match get_public_key_fingerprint"
+#endif
+
+static int compare_fingerprints(const void *a, const void *b)
+{
+    return memcmp(a, b, MLLE_SSL_FINGERPRINT_LEN);
+}
+
 /*************************************************************
  * Validate the Tool public key against a list of
  * trusted public keys. If key is not valid the Tool is not
  * approved and can't use all the library commands.
+ * The keys are compared by their SHA-256 fingerprints, which
+ * the build generates as a sorted table, obfuscated like the
+ * keys were. The table is decoded for the check only.
  *
  * Returns:
  *      1 - the public key is valid.
@@ -65,26 +78,19 @@ void mlle_lve_validate_pubkey(struct mlle_lve_ctx *lve_ctx)
  ************************************************************/
 int validate()
 {
-    int result = 1;
-    int i;
-    DECLARE_PUBLIC_KEY_TOOL();
+    int found = 0;
+    DECLARE_PUBLIC_KEY_TOOL_FINGERPRINTS();
 
-    // TODO check with several tool keys.
-    INITIALIZE_PUBLIC_KEY_TOOL();
-    // global_tool_pub_key is the public key received in
-    // the LVE:s callback method during TLS handshake.
-    for (i = 0; i < PUBLIC_KEY_TOOL_NUM; i++){
-        if (strcmp(global_tool_pub_key, PUBLIC_KEY_TOOL[i]) == 0)
-        {
-            /* Found matching key. */
-            break;            
-        }
-    }
-    if (i == PUBLIC_KEY_TOOL_NUM) {
-        /* Validation failed. */
-        result = 0;
+    // global_tool_pub_key_fingerprint is the fingerprint of the public
+    // key received in the LVE:s callback method during TLS handshake.
+    if (!global_tool_pub_key_received)
+    {
+        return 0;
     }
-    CLEAR_PUBLIC_KEY_TOOL();
-
-    return result;
+    INITIALIZE_PUBLIC_KEY_TOOL_FINGERPRINTS();
+    found = bsearch(global_tool_pub_key_fingerprint, PUBLIC_KEY_TOOL_FINGERPRINTS,
+                    PUBLIC_KEY_TOOL_FINGERPRINT_NUM, MLLE_SSL_FINGERPRINT_LEN,
+                    compare_fingerprints) != NULL;
+    CLEAR_PUBLIC_KEY_TOOL_FINGERPRINTS();
+    return found;
 }
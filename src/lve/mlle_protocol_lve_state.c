@@ -33,8 +33,10 @@ mlle_lve_valid_command_for_state[MLLE_PROTOCOL_COMMAND_ID_SIZE][MLLE_LVE_STATE_S
 /* LE_NOTSIMPLE_CMD     */ { MLLE_LVE_STATE_INVALID },
 /* LE_TOOLS_CMD         */ { MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_LIB,      MLLE_LVE_STATE_INVALID },
 /* LE_YES_CMD           */ { MLLE_LVE_STATE_INVALID },
+/* LE_STATS_CMD         */ { MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_LICENSE },
 /* LE_VERSION_CMD       */ { MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_TOOLS,    MLLE_LVE_STATE_INVALID },
 /* LE_FEATURE_CMD       */ { MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_LICENSE },
+/* LE_FEATURES_CMD      */ { MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_LICENSE },
 /* LE_FILE_CMD          */ { MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_LICENSE },
 /* LE_FILECONT_CMD      */ { MLLE_LVE_STATE_INVALID },
 /* LE_LIB_CMD           */ { MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_LICENSE,   MLLE_LVE_STATE_LICENSE},
@@ -42,6 +44,7 @@ mlle_lve_valid_command_for_state[MLLE_PROTOCOL_COMMAND_ID_SIZE][MLLE_LVE_STATE_S
 /* LE_NO_CMD            */ { MLLE_LVE_STATE_INVALID },
 /* LE_RETURNFEATURE_CMD */ { MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_LICENSE },
 /* LE_RETURNLICENSE_CMD */ { MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_INVALID,  MLLE_LVE_STATE_LICENSE },
+/* LE_STATSCONT_CMD     */ { MLLE_LVE_STATE_INVALID },
 /* LE_TOOLLIST_CMD      */ { MLLE_LVE_STATE_INVALID },
 /* LE_ERROR_CMD         */ { MLLE_LVE_STATE_INVALID },
 };
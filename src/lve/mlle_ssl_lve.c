@@ -30,6 +30,7 @@
 #include "mlle_ssl.h"
 #include "mlle_error.h"
 #include "mlle_ssl_lve.h"
+#include "mlle_stats.h"
 
 #include "private_key_lve.h"
 
@@ -38,7 +39,7 @@
 /**************************************************************
  * This method catches the certificate the client sends.
  * We are only interested in the public key from the client
- * so we extract the key and tell the server that the
+ * so we store its fingerprint and tell the server that the
  * certificate is valid (i.e. return 1).
  *
  * Parameters:
@@ -46,44 +47,26 @@
  *      arg - arguments. Not in use here.
  *
  * Returns:
- *      1 - public key was extracted with success.
- *      0 - failed to extract key (handshake will fail).
+ *      1 - public key was fingerprinted with success.
+ *      0 - failed to get the key (handshake will fail).
  *************************************************************/
 static int cert_verify_callback(X509_STORE_CTX *ctx, void *arg)
 {
-    EVP_PKEY *public_key = NULL;
     X509 *x509 = NULL;
-    RSA *rsa = NULL;
 
     // Get the certificate.
-
-
     x509 = X509_STORE_CTX_get0_cert(ctx);
     if (x509 == NULL)
     {
             return 0;
     }
 
-    // Get public key with DER encoding.
-    if ( (public_key = X509_get_pubkey(x509)) == NULL)
-    {
-        return 0;
-    }
-
-    // Get RSA with public key.
-    if ( (rsa = EVP_PKEY_get1_RSA(public_key)) == NULL)
-    {
-        return 0;
-    }
-
-    // Extract public key in PEM format and store it globally.
-    if ( (global_tool_pub_key = get_public_key(rsa)) == NULL)
+    // Hash the DER encoded public key and store it globally.
+    if (!get_public_key_fingerprint(x509, global_tool_pub_key_fingerprint))
     {
         return 0;
     }
-
-    RSA_free(rsa);
-    EVP_PKEY_free(public_key);
+    global_tool_pub_key_received = 1;
 
     return 1;
 }
@@ -111,12 +94,15 @@ int ssl_setup_lve(struct mlle_lve_ctx *lve_ctx)
     RSA *rsa = NULL;
     X509 *x509;
     int result = 0;
+    mlle_stats_ns start = mlle_stats_now();
     DECLARE_PRIVATE_KEY_LVE();
 
     // Initiate ssl.
     init_ssl();
+    mlle_stats_startup(MLLE_STATS_STARTUP_INIT_SSL, start);
 
     // Initiate CTX structure.
+    start = mlle_stats_now();
     INITIALIZE_PRIVATE_KEY_LVE();
     if ( (ctx = create_CTX((char *) PRIVATE_KEY_LVE, SERVER)) == NULL)
     {
@@ -133,6 +119,7 @@ int ssl_setup_lve(struct mlle_lve_ctx *lve_ctx)
         goto cleanup;
     }
     CLEAR_PRIVATE_KEY_LVE();
+    mlle_stats_startup(MLLE_STATS_STARTUP_KEY_PARSE, start);
 
     // Add callback method so we can get hold of the Tool certificate.
     SSL_CTX_set_cert_verify_callback (ctx, cert_verify_callback, NULL);
@@ -156,12 +143,14 @@ int ssl_setup_lve(struct mlle_lve_ctx *lve_ctx)
     BIO_set_nbio(bioRead, 1);
 
     // Create self-signed certificate.
+    start = mlle_stats_now();
     if ( (x509 = generate_X509(rsa)) == NULL)
     {
         lve_ctx->tool_error_type = MLLE_PROTOCOL_SSL_ERROR;
         lve_ctx->tool_error_msg = "SSL: Failed to create server X509 certificate.";
         goto cleanup;
     }
+    mlle_stats_startup(MLLE_STATS_STARTUP_X509, start);
 
     // Setup the SSL structure.
     ssl = SSL_new(ctx);
@@ -210,6 +199,7 @@ int lve_perform_handshake(struct mlle_lve_ctx *lve_ctx)
     int result = 0;
     int errorCode = 0;
     char errorString[SSL_ERROR_BUF_LEN];
+    mlle_stats_ns start = mlle_stats_now();
 
     if ( (lve_ctx == NULL) || (lve_ctx->ssl == NULL) )
     {
@@ -227,6 +217,7 @@ int lve_perform_handshake(struct mlle_lve_ctx *lve_ctx)
 
         return 0;
     }
+    mlle_stats_startup(MLLE_STATS_STARTUP_ACCEPT, start);
 
     return 1;
 }
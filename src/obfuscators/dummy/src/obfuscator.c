@@ -18,16 +18,34 @@
 
 #include <stdio.h>
 
+/* Length of the keystream that the data is xored with, a power of two. */
+#define KEYSTREAM_LEN 16
+
+/*
+ * Writes the data as a table xor a short keystream, see write_table_decode_body.
+ * The keystream is derived from the data so that the output is reproducible;
+ * this hides the data from a plain search of the binary, nothing more.
+ */
 void write_initialize_key_macro_body(FILE* out, 
                                      key_type type, 
                                      char* buffer_name, 
                                      unsigned char* data, 
                                      size_t data_len) {
-    int i;
-    
+    unsigned char keystream[KEYSTREAM_LEN];
+    unsigned long state = 2166136261UL;
+    size_t i;
+
+    /* FNV-1a of the data seeds a xorshift generator. */
     for (i = 0; i < data_len; i++) {
-        fprintf(out, "%s[%u] = '\\x%x'; ", buffer_name, i, (unsigned int) data[i]);
+        state = ((state ^ data[i]) * 16777619UL) & 0xffffffffUL;
+    }
+    for (i = 0; i < KEYSTREAM_LEN; i++) {
+        state ^= (state << 13) & 0xffffffffUL;
+        state ^= state >> 17;
+        state ^= (state << 5) & 0xffffffffUL;
+        keystream[i] = (unsigned char) (state >> 24);
     }
+    write_table_decode_body(out, buffer_name, data, data_len, keystream, KEYSTREAM_LEN);
 }
 
 void write_header_extra(FILE* out, 
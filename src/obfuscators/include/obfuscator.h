@@ -20,6 +20,11 @@
 #include <stdio.h>
 
 
+/*
+ * What the data given to write_initialize_key_macro_body is.
+ * TOOL_PUBLIC is the table of SHA-256 fingerprints of the trusted tool
+ * public keys, written by fingerprint_keys, and not a key in PEM format.
+ */
 typedef enum { 
     ENCRYPT, 
     TOOL_PUBLIC, 
@@ -39,4 +44,20 @@ void write_header_extra(FILE* out,
                         key_type type);
 
 
+/*
+ * For use by obfuscator modules in write_initialize_key_macro_body, instead of writing
+ * one statement per byte: writes a static const table of data xor keystream, followed
+ * by a loop that xors keystream back into buffer_name. The iterations of the loop are
+ * independent, so that compilers can vectorise it, and the size of the code does not
+ * grow with data_len. keystream_len must be a power of two.
+ * Implemented by the programs that use the obfuscator module, see obfuscate_utils.c.
+ */
+void write_table_decode_body(FILE* out,
+                             char* buffer_name,
+                             const unsigned char* data,
+                             size_t data_len,
+                             const unsigned char* keystream,
+                             size_t keystream_len);
+
+
 #endif /* _OBFUSCATOR_H_ */
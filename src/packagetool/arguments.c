@@ -43,9 +43,12 @@ char *validArguments[MAX_ARGUMENTS] = {
     ARGUMENT_COPYRIGHT, 
     ARGUMENT_LICENSE, 
     ARGUMENT_ENCRYPT, 
+    ARGUMENT_ENCRYPTION_FORMAT,
     ARGUMENT_ICON_PATH, 
     ARGUMENT_TOOLS_FILE, 
-    ARGUMENT_DEPENDENCIES_FILE
+    ARGUMENT_DEPENDENCIES_FILE,
+    ARGUMENT_THREADS,
+    ARGUMENT_STREAM
 };
 
 
@@ -322,6 +325,22 @@ int validateEncryption()
         }
     }
 
+    // Is the encryption format known.
+    if (containsKey(ARGUMENT_ENCRYPTION_FORMAT) && getEncryptionFormat() == 0)
+    {
+        printf("Error: Encryption format %s is not valid, use cbc, gcm or chunked.\n",
+               getValueOf(ARGUMENT_ENCRYPTION_FORMAT));
+        return 0;
+    }
+
+    // Is the number of threads valid.
+    if (containsKey(ARGUMENT_THREADS) && getThreadCount() == 0)
+    {
+        printf("Error: Number of threads %s is not valid, use a number of at least 1.\n",
+               getValueOf(ARGUMENT_THREADS));
+        return 0;
+    }
+
     return 1;
 }
 
@@ -540,9 +559,20 @@ void printArgumentHelp(void)
         {ARGUMENT_ENCRYPT, "If the value of this argument is true then LVEs must be copied to the .library directory of "
                           "the source structure. If the path to copy from is wrong or LVEs are missing or have the "
                           "wrong names the tool will abort."},
+        {ARGUMENT_ENCRYPTION_FORMAT, "Format of the encrypted files, cbc (default), gcm or chunked. Files in the gcm "
+                                    "format (AES-256-GCM) are faster to decrypt, and files in the chunked format "
+                                    "(AES-256-GCM in 64 KiB chunks) can also be decrypted and verified a part at a "
+                                    "time, but both can only be read by LVEs built from a version of SEMLA that "
+                                    "supports them."},
         {ARGUMENT_ICON_PATH, "An icon to use for the library. If the supplied path to the icon file is wrong or the file "
                             "can't be located in the library structure the tool will abort."},
+        {ARGUMENT_THREADS, "Number of threads to encrypt and compress files on, by default one per processor. The "
+                          "package.mo of each directory is encrypted before the other files in it and its "
+                          "subdirectories. The archive is the same for any number of threads."},
         {ARGUMENT_LICENSE, "Textual license information."},
+        {ARGUMENT_STREAM, "If the value of this argument is true then the library is not copied to a temporary "
+                         "folder. Each file is read once from the library path, encrypted in memory if needed, "
+                         "and written to the archive. Only the .library folder is made in a temporary folder."},
         {ARGUMENT_TITLE, "Official title of the library."},
         {ARGUMENT_TOOLS_FILE, "Adds a list of Modelica tools (in an xml file) that this library is compatible with. If the "
                              "supplied path to the tool-xml file is wrong the tool will abort."}
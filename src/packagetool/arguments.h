@@ -19,7 +19,7 @@
 
 #define NO_OF_MANDATORY_ARGUMENTS 3
 #define NO_HELP_ARGUMENTS         2
-#define MAX_ARGUMENTS             14
+#define MAX_ARGUMENTS             17
 
 #define ARGUMENT_LIBRARY_PATH      "librarypath"
 #define ARGUMENT_ENABLED           "enabled"
@@ -32,9 +32,12 @@
 #define ARGUMENT_COPYRIGHT         "copyright"
 #define ARGUMENT_LICENSE           "license"
 #define ARGUMENT_ENCRYPT           "encrypt"
+#define ARGUMENT_ENCRYPTION_FORMAT "encryptionformat"
 #define ARGUMENT_ICON_PATH         "icon"
 #define ARGUMENT_TOOLS_FILE        "tools"
 #define ARGUMENT_DEPENDENCIES_FILE "dependencies"
+#define ARGUMENT_THREADS           "j"
+#define ARGUMENT_STREAM            "stream"
 #define ARGUMENT_HELP              "--help"
 #define ARGUMENT_SHORT_HELP        "-h"
 
@@ -120,7 +123,8 @@ int validateLibraryPath();
  * Returns:
  *      1 or higher - some LVE was found OR encrypt argument
  *                    not used.
- *      0 - encrypt argument used and no LVE was found.
+ *      0 - encrypt argument used and no LVE was found, or
+ *          the encryption format is not valid.
  *************************************************************/
 int validateEncryption();
 
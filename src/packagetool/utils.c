@@ -20,17 +20,21 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+// For copy_file_range.
+#if defined linux && !defined _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
-#ifdef WIN32
 #include "../../ThirdParty/miniz/miniz.c"
-#else
-#include <zip.h>
-#endif
 
 #include "arguments.h"
 #include "mlle_cr_decrypt.h"
@@ -49,10 +53,44 @@
 #include <unistd.h>
 #endif
 
+#if defined linux
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+
 #include "mlle_portability.h"
 
 // Encryption
 #include "mlle_cr_encrypt.h"
+#include "mlle_thread.h"
+
+// -------------------------------------------------------------
+// The zip archive. Files are compressed in memory ZIP_BATCH_LEN
+// bytes at a time, see writeZipArchive. Files larger than
+// ZIP_STREAM_LEN are compressed ZIP_CHUNK_LEN bytes at a time
+// while they are written, see writeStreamedZipEntry.
+// Sizes, offsets and counts that don't fit the zip format are
+// written in zip64 extra fields and end records.
+// -------------------------------------------------------------
+#define ZIP_COMPRESSION_LEVEL MZ_BEST_COMPRESSION
+#define ZIP_BATCH_LEN (64 * 1024 * 1024)
+#define ZIP_STREAM_LEN (16 * 1024 * 1024)
+#define ZIP_CHUNK_LEN (1024 * 1024)
+#define ZIP_VERSION 20
+#define ZIP64_VERSION 45
+#define ZIP_LOCAL_HEADER_LEN 30
+#define ZIP_CENTRAL_HEADER_LEN 46
+#define ZIP_END_LEN 22
+#define ZIP64_END_LEN 56
+#define ZIP64_LOCATOR_LEN 20
+#define ZIP64_EXTRA_MAX_LEN 28
+#define ZIP_MAX_SIZE 0xFFFFFFFFULL
+#define ZIP_MAX_COUNT 0xFFFF
+
+// Size of the buffer that copyFile copies through when the kernel can't
+// copy a file by itself.
+#define COPY_BUFFER_LEN (1024 * 1024)
 
 // ------------------------------------
 // These are the LVE's currently used.
@@ -662,6 +700,7 @@ int prepareIconFile()
 int locateIconFile()
 {
     char *filename = NULL;
+    char *path = NULL;
     char *value = NULL;
     int result = 0;
     int i = 0;
@@ -677,12 +716,14 @@ int locateIconFile()
     // Extract filename from the path.
     filename = extractFilename(value);
 
-    // Try to find the file.
+    // Try to find the file, in the library itself when streaming.
+    path = usingStreaming() ? getValueOf(ARGUMENT_LIBRARY_PATH)
+                            : getCopiedSourcePath();
 #ifdef WIN32
     // Result is always 1.
-    result = findFileWin32(filename, getCopiedSourcePath());
+    result = findFileWin32(filename, path);
 #else
-    result = findFileLinux(filename, getCopiedSourcePath());
+    result = findFileLinux(filename, path);
 #endif
 
     // Abort if we didn't find the file.
@@ -914,100 +955,102 @@ int findFileWin32(const char *filename, const char *path)
     return result;
 }
 
-int encryptDirectoryWin32(const char *topLevelPath, const char *relPath,
-                          mlle_cr_context *context_in)
+/*****************************************************
+ * Add a file to the list of files to encrypt.
+ ****************************************************/
+static int addEncryptJob(EncryptJobList *list, const char *relPath,
+                         int packageDepth)
+{
+    EncryptJob *jobs;
+    size_t capacity;
+
+    if (list->count == list->capacity) {
+        capacity = list->capacity ? 2 * list->capacity : 256;
+        jobs = (EncryptJob *)realloc(list->jobs, capacity * sizeof(EncryptJob));
+        if (jobs == NULL) {
+            printf("Error: Could not allocate memory for the files to encrypt.\n");
+            return 0;
+        }
+        list->jobs = jobs;
+        list->capacity = capacity;
+    }
+    list->jobs[list->count].relPath = strdup(relPath);
+    list->jobs[list->count].packageDepth = packageDepth;
+    if (list->jobs[list->count].relPath == NULL) {
+        printf("Error: Could not allocate memory for the files to encrypt.\n");
+        return 0;
+    }
+    list->count++;
+
+    return 1;
+}
+
+int findFilesToEncryptWin32(const char *topLevelPath, const char *relPath,
+                            int depth, EncryptJobList *list)
 {
     int result = 1;
 #ifdef WIN32
     WIN32_FIND_DATA fdFile;
     HANDLE hFind = NULL;
-    char fullPath[MAX_PATH_LENGTH + 1];
     char searchPath[MAX_PATH_LENGTH + 1];
-    size_t path_len = 0;
-    FILE *in;
 
-    mlle_cr_context *context = context_in;
-
-    // Find all.
-    if (NULL == context) {
-        context = mlle_cr_create(topLevelPath);
-        if (NULL == context) {
-            printf("Could not allocated memory for encryption context\n");
-            return 0;
-        }
-        snprintf(fullPath, MAX_PATH_LENGTH + 1, "%s", topLevelPath);
-    } else {
-        snprintf(fullPath, MAX_PATH_LENGTH + 1, "%s\\%s", topLevelPath,
+    if (relPath) {
+        snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s\\%s\\*.*", topLevelPath,
                  relPath);
+    } else {
+        snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s\\*.*", topLevelPath);
     }
-    snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s\\*.*", fullPath);
     // Try to find file in top-level directory.
     if ((hFind = FindFirstFile(searchPath, &fdFile)) == INVALID_HANDLE_VALUE) {
         printf("Encrypt directory failed for path %s.\n", searchPath);
         return 0;
     }
 
-    snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s\\package.mo", fullPath);
-    in = fopen(searchPath, "rb");
-    if (in) {
-        fclose(in);
-        if (relPath) {
-            snprintf(searchPath, MAX_PATH_LENGTH + 1,
-                     "%s\\"
-                     "package.mo"
-                     "",
-                     relPath);
-            result = encryptFile(context, topLevelPath, searchPath);
-        } else {
-            result = encryptFile(context, topLevelPath, "package.mo");
-        }
-    }
-    if (result) {
-        do {
-            // The first two directories are always "." and "..".
-            if (strcmp(fdFile.cFileName, ".") != 0 &&
-                strcmp(fdFile.cFileName, "..") != 0 &&
-                _stricmp(fdFile.cFileName, "package.mo") != 0) {
-                if (relPath) {
-                    snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s\\%s", relPath,
-                             fdFile.cFileName);
-                } else {
-                    snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s",
-                             fdFile.cFileName);
-                }
-                // Have we found a folder?
-                if (fdFile.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-                    // Use recursive to check the folder we found.
-                    if (!encryptDirectoryWin32(topLevelPath, searchPath,
-                                               context)) {
-                        result = 0;
-                        break;
-                    };
-                }
-                // Or a regular file?
-                else if (fdFile.dwFileAttributes) {
-                    // Encrypt Modelica files.
-                    if (isModelicaFile(fdFile.cFileName)) {
-                        result = encryptFile(context, topLevelPath, searchPath);
-                    }
-                }
+    do {
+        // The first two directories are always "." and "..".
+        if (strcmp(fdFile.cFileName, ".") != 0 &&
+            strcmp(fdFile.cFileName, "..") != 0) {
+            if (relPath) {
+                snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s\\%s", relPath,
+                         fdFile.cFileName);
+            } else {
+                snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s",
+                         fdFile.cFileName);
             }
-        } while (FindNextFile(hFind, &fdFile) && result); // Find the next file
-    }
+            // Have we found a folder?
+            if (fdFile.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                // Use recursive to check the folder we found.
+                result = findFilesToEncryptWin32(topLevelPath, searchPath,
+                                                 depth + 1, list);
+            }
+            // Or the package.mo, which must be encrypted first?
+            else if (_stricmp(fdFile.cFileName, "package.mo") == 0) {
+                result = addEncryptJob(list, searchPath, depth);
+            }
+            // Or another Modelica file?
+            else if (fdFile.dwFileAttributes &&
+                     isModelicaFile(fdFile.cFileName)) {
+                result = addEncryptJob(list, searchPath, -1);
+            }
+        }
+    } while (result && FindNextFile(hFind, &fdFile)); // Find the next file
     FindClose(hFind);
-    if (context && (context_in == NULL)) {
-        mlle_cr_free(context);
-    }
+#else
+    (void) topLevelPath;
+    (void) relPath;
+    (void) depth;
+    (void) list;
 #endif
 
     return result;
 }
 
 /***********************************************************
- * Encrypt modelica files in a directory structure on Linux .
+ * Find modelica files to encrypt in a directory structure
+ * on Linux.
  ***********************************************************/
-int encryptDirectoryLinux(const char *topLevelPath, const char *relPath,
-                          mlle_cr_context *context_in)
+int findFilesToEncryptLinux(const char *topLevelPath, const char *relPath,
+                            int depth, EncryptJobList *list)
 {
     int result = 1;
 
@@ -1016,77 +1059,47 @@ int encryptDirectoryLinux(const char *topLevelPath, const char *relPath,
     struct dirent *dir;
     char fullPath[MAX_PATH_LENGTH + 1];
     char searchPath[MAX_PATH_LENGTH + 1];
-    size_t path_len = 0;
-    mlle_cr_context *context = context_in;
-    FILE *in;
 
-    // Find all.
-    if (NULL == context) {
-        context = mlle_cr_create(topLevelPath);
-        if (NULL == context) {
-            printf("Could not allocated memory for encryption context\n");
-            return 0;
-        }
-        snprintf(fullPath, MAX_PATH_LENGTH + 1, "%s", topLevelPath);
-    } else {
+    if (relPath) {
         snprintf(fullPath, MAX_PATH_LENGTH + 1, "%s/%s", topLevelPath, relPath);
-    }
-    // Find all.
-    snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s/package.mo", fullPath);
-    in = fopen(searchPath, "rb");
-    if (in) {
-        fclose(in);
-        if (relPath) {
-            snprintf(searchPath, MAX_PATH_LENGTH + 1,
-                     "%s/package.mo"
-                     "",
-                     relPath);
-            result = encryptFile(context, topLevelPath, searchPath);
-        } else {
-            result = encryptFile(context, topLevelPath, "package.mo");
-        }
+    } else {
+        snprintf(fullPath, MAX_PATH_LENGTH + 1, "%s", topLevelPath);
     }
 
-    if (result && (d = opendir(fullPath))) {
-        while ((dir = readdir(d)) != NULL && (result == 1)) {
-            // The first two directories are always "." and "..".
-            if (strcmp(dir->d_name, ".") != 0 &&
-                strcmp(dir->d_name, "..") != 0 &&
-                strcasecmp(dir->d_name, "package.mo") != 0) {
-                if (relPath) {
-                    snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s/%s", relPath,
-                             dir->d_name);
-                } else {
-                    snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s",
-                             dir->d_name);
-                }
+    if ((d = opendir(fullPath)) == NULL) {
+        printf("Failed to open directory %s\n", fullPath);
+        return 0;
+    }
+    while (result && (dir = readdir(d)) != NULL) {
+        // The first two directories are always "." and "..".
+        if (strcmp(dir->d_name, ".") != 0 && strcmp(dir->d_name, "..") != 0) {
+            if (relPath) {
+                snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s/%s", relPath,
+                         dir->d_name);
+            } else {
+                snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s", dir->d_name);
+            }
 
-                // Have we found a folder?
-                if (dir->d_type == DT_DIR) {
-                    // Use recursive to check the folder we found.
-                    if (!encryptDirectoryLinux(topLevelPath, searchPath,
-                                               context)) {
-                        result = 0;
-                        break;
-                    }
+            // Have we found a folder?
+            if (dir->d_type == DT_DIR) {
+                // Use recursive to check the folder we found.
+                result = findFilesToEncryptLinux(topLevelPath, searchPath,
+                                                 depth + 1, list);
+            }
+            // Or a file?
+            else if (dir->d_type == DT_REG) {
+                // The package.mo must be encrypted first.
+                if (strcasecmp(dir->d_name, "package.mo") == 0) {
+                    result = addEncryptJob(list, searchPath, depth);
                 }
-                // Or a file?
-                else if (dir->d_type == DT_REG) {
-                    // Encrypt Modelica files.
-                    if (isModelicaFile(dir->d_name)) {
-                        result = encryptFile(context, topLevelPath, searchPath);
-                    }
+                // Encrypt Modelica files.
+                else if (isModelicaFile(dir->d_name)) {
+                    result = addEncryptJob(list, searchPath, -1);
                 }
             }
         }
-        closedir(d);
-    } else {
-        printf("Failed to open directory %s\n", searchPath);
-        result = 0;
-    }
-    if (context && (context_in == NULL)) {
-        mlle_cr_free(context);
     }
+    closedir(d);
 
 #endif
 
@@ -1306,219 +1319,962 @@ int encryptFile(mlle_cr_context *context, const char *basedir,
     return result;
 }
 
-/******************
- * Encrypt files.
- *****************/
-int encryptFiles()
+/*****************************************************
+ * Order files to encrypt: package.mo files by the
+ * depth of their directory, then all other files.
+ ****************************************************/
+static int compareEncryptJobs(const void *a, const void *b)
 {
-    int result = 1;
+    int depthA = ((const EncryptJob *)a)->packageDepth;
+    int depthB = ((const EncryptJob *)b)->packageDepth;
 
-    if (usingEncryption()) {
-#ifdef WIN32
-        result = encryptDirectoryWin32(getCopiedSourcePath(), 0, 0);
-#else
-        result = encryptDirectoryLinux(getCopiedSourcePath(), 0, 0);
-#endif
+    if (depthA < 0) {
+        depthA = INT_MAX;
     }
+    if (depthB < 0) {
+        depthB = INT_MAX;
+    }
+    return (depthA > depthB) - (depthA < depthB);
+}
 
-    return result;
+/*****************************************************
+ * Do the work of a ThreadWork, taking the next index
+ * until all are done or one has failed.
+ ****************************************************/
+static void threadWorker(void *arg)
+{
+    ThreadWork *work = (ThreadWork *)arg;
+    size_t i;
+    int ok;
+
+    for (;;) {
+        mlle_mutex_lock(work->mutex);
+        i = work->next++;
+        ok = !work->failed;
+        mlle_mutex_unlock(work->mutex);
+        if (!ok || i >= work->end) {
+            break;
+        }
+
+        if (!work->work(work->arg, i)) {
+            mlle_mutex_lock(work->mutex);
+            work->failed = 1;
+            mlle_mutex_unlock(work->mutex);
+        }
+    }
 }
 
-/*****************************
- * Create a zipped archive.
- ****************************/
-int createZipArchive()
+/*****************************************************
+ * Run work for each index from begin to end on
+ * nThreads threads, and wait for all of them.
+ ****************************************************/
+static int runOnThreads(ThreadWork *work, size_t begin, size_t end,
+                        int nThreads)
 {
-    int result = 0;
-    int status = 0;
-    char *cwd = NULL;
-    char archiveName[MAX_STRING] = {'\0'};
-    char pathToZipfile[MAX_PATH_LENGTH] = {'\0'};
-    char currentDir[MAX_PATH_LENGTH] = {'\0'};
-    int encrypted = 0;
-    struct zip_t *zip = NULL;
+    struct mlle_thread *threads[MAX_THREADS];
+    int i;
 
-    // Get last folder name in library path. This will
-    // be the name of the archive.
-    snprintf(archiveName, MAX_STRING, "%s.mol", getLibraryName());
+    if (nThreads > MAX_THREADS) {
+        nThreads = MAX_THREADS;
+    }
+    if ((size_t)nThreads > end - begin) {
+        nThreads = (int)(end - begin);
+    }
+    work->next = begin;
+    work->end = end;
 
-    // Is library encrypted. If so, don't put the .mo-files in the archive.
-    if (usingEncryption()) {
-        encrypted = 1;
+    // The main thread is one of the workers.
+    for (i = 1; i < nThreads; i++) {
+        threads[i] = mlle_thread_start(threadWorker, work);
+    }
+    threadWorker(work);
+    for (i = 1; i < nThreads; i++) {
+        if (threads[i]) {
+            mlle_thread_join(threads[i]);
+        }
     }
 
-    // Get current directory.
-    if (getCurrentDirectory(&cwd)) {
-        snprintf(pathToZipfile, MAX_PATH_LENGTH, "%s/%s", cwd, archiveName);
+    return !work->failed;
+}
 
-        // Remove any previous zip-file.
-        if (fileExists(pathToZipfile)) {
-            remove(pathToZipfile);
-        }
+/*****************************************************
+ * Encrypt file number index of the list.
+ ****************************************************/
+static int encryptJob(void *arg, size_t index)
+{
+    EncryptState *state = (EncryptState *)arg;
+
+    return encryptFile(state->context, state->topLevelPath,
+                       state->list->jobs[index].relPath);
+}
+
+/******************
+ * Encrypt files.
+ *****************/
+int encryptFiles()
+{
+    EncryptJobList list = {NULL, 0, 0};
+    EncryptState state;
+    ThreadWork work;
+    size_t begin, end;
+    int nThreads = getThreadCount();
+    int result = 1;
+
+    // When streaming, files are encrypted as they are zipped.
+    if (!usingEncryption() || usingStreaming()) {
+        return 1;
+    }
+
+    memset(&state, 0, sizeof(state));
+    memset(&work, 0, sizeof(work));
+    state.topLevelPath = getCopiedSourcePath();
+    state.list = &list;
+    state.context = mlle_cr_create(state.topLevelPath);
+    if (NULL == state.context) {
+        printf("Could not allocated memory for encryption context\n");
+        return 0;
+    }
+    if (!mlle_cr_set_format(state.context, getEncryptionFormat())) {
+        printf("Encryption format is not supported by the decryptor\n");
+        result = 0;
+        goto cleanup;
+    }
+    work.work = encryptJob;
+    work.arg = &state;
+    work.mutex = mlle_mutex_new();
+    if (work.mutex == NULL) {
+        printf("Could not allocated memory for encryption threads\n");
+        result = 0;
+        goto cleanup;
     }
 
 #ifdef WIN32
-    result =
-        zipDirectoryWin32(getTempStagingDirectory(), archiveName, encrypted);
+    result = findFilesToEncryptWin32(state.topLevelPath, NULL, 0, &list);
 #else
-    status = openZipArchive(&zip, archiveName);
-    if (1 != status) {
-        goto error;
-    }
-    result = zipDirectoryLinux(zip, getTempStagingDirectory(), archiveName,
-                               encrypted);
+    result = findFilesToEncryptLinux(state.topLevelPath, NULL, 0, &list);
 #endif
-error:
-    closeZipArchive(zip);
+    if (!result) {
+        goto cleanup;
+    }
+
+    // The key mask of a directory is made when its package.mo is encrypted,
+    // and the other files in it and its subdirectories are encrypted with it.
+    // So encrypt the package.mo files a level at a time, and then all other
+    // files, each stage on all threads.
+    qsort(list.jobs, list.count, sizeof(EncryptJob), compareEncryptJobs);
+    for (begin = 0; result && begin < list.count; begin = end) {
+        end = begin + 1;
+        while (end < list.count &&
+               list.jobs[end].packageDepth == list.jobs[begin].packageDepth) {
+            end++;
+        }
+        result = runOnThreads(&work, begin, end, nThreads);
+    }
+
+cleanup:
+    for (begin = 0; begin < list.count; begin++) {
+        free(list.jobs[begin].relPath);
+    }
+    free(list.jobs);
+    mlle_mutex_free(work.mutex);
+    mlle_cr_free(state.context);
+
     return result;
 }
 
-/******************************************************
- * Creates a zipped archive of a directory on Windows.
- *****************************************************/
-int zipDirectoryWin32(char *path, char *archiveName, int encrypted)
+/*****************************************************
+ * Add a file to the list of files to zip, as zipPath
+ * in the archive. A Modelica file is encrypted when
+ * it is zipped if encrypt is set.
+ ****************************************************/
+static int addZipEntry(ZipEntryList *list, char *path, const char *zipPath,
+                       int encrypt)
 {
-    int result = 0;
-#ifdef WIN32
-    WIN32_FIND_DATA fData;
-    HANDLE hFind = NULL;
-    char searchPath[MAX_PATH_LENGTH];
-
-    FILE *fd = NULL;
+    ZipEntry *entries;
+    ZipEntry *entry;
+    size_t capacity;
     struct stat info;
-    char *data = NULL;
-    size_t bytes = 0;
-    int index = 0;
-    char *comment = "Modelica_archive";
-    unsigned long buffertSize = 0;
-    char zipPath[MAX_PATH_LENGTH] = {'\0'};
-
-    // Find all.
-    snprintf(searchPath, MAX_PATH_LENGTH, "%s\\*.*", path);
+    const char *name = NULL;
+    const char *ptr = NULL;
 
-    // Try to find file in top-level directory.
-    if ((hFind = FindFirstFile(searchPath, &fData)) == INVALID_HANDLE_VALUE) {
-        printf("Error creating archive starting from \"%s\".\n", path);
+    if (stat(path, &info) != 0) {
+        printf("Error: Failed to read information of file \"%s\".\n", path);
+        return 0;
+    }
+    if (list->count == list->capacity) {
+        capacity = list->capacity ? 2 * list->capacity : 256;
+        entries = (ZipEntry *)realloc(list->entries, capacity * sizeof(ZipEntry));
+        if (entries == NULL) {
+            printf("Error: Could not allocate memory for the files to zip.\n");
+            return 0;
+        }
+        list->entries = entries;
+        list->capacity = capacity;
+    }
+    entry = &list->entries[list->count];
+    memset(entry, 0, sizeof(ZipEntry));
+    entry->path = strdup(path);
+    entry->size = (size_t)info.st_size;
+    entry->mode = (unsigned int)info.st_mode;
+    entry->mtime = info.st_mtime;
+    entry->packageDepth = -1;
+    entry->streamed = entry->size > ZIP_STREAM_LEN;
+    list->count++;
+    if (entry->path == NULL) {
+        printf("Error: Could not allocate memory for the files to zip.\n");
         return 0;
     }
 
-    do {
-        // The first two directories are always "." and "..".
-        if (strcmp(fData.cFileName, ".") != 0 &&
-            strcmp(fData.cFileName, "..") != 0) {
-            // Build up our file path using the passed in
-            // [path] and the file/foldername we just found:
-            snprintf(searchPath, MAX_PATH_LENGTH, "%s\\%s", path,
-                     fData.cFileName);
+    if (!encrypt) {
+        entry->zipPath = strdup(zipPath);
+    } else {
+        // Encrypted for its path within the library, and added as .moc.
+        entry->encryptPath = strdup(strchr(zipPath, '/') + 1);
+        if ((entry->zipPath = malloc(strlen(zipPath) + 2)) != NULL) {
+            sprintf(entry->zipPath, "%sc", zipPath);
+        }
 
-            // Have we found a folder?
-            if (fData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-                // Use recursive to check the folder we found.
-                result = zipDirectoryWin32(searchPath, archiveName, encrypted);
-                if (1 != result) {
-                    return 0;
-                }
+        // A package.mo is encrypted before the files in its directory and
+        // subdirectories, see writeZipArchive.
+        name = strrchr(zipPath, '/') + 1;
+        if (strcasecmp(name, "package.mo") == 0) {
+            entry->packageDepth = 0;
+            for (ptr = zipPath; ptr < name - 1; ptr++) {
+                entry->packageDepth += (*ptr == '/');
             }
+        }
+    }
+    if (entry->zipPath == NULL || (encrypt && entry->encryptPath == NULL)) {
+        printf("Error: Could not allocate memory for the files to zip.\n");
+        return 0;
+    }
 
-            // Or a regular file?
-            else if (fData.dwFileAttributes) {
-                // -------------------------------------------------------------
-                // Only add file to archive when:
-                // 1. Files are not encrypted.
-                // 2. Files are encrypted and the file is not a Modelica file.
-                // -------------------------------------------------------------
-                if ((!encrypted) ||
-                    ((encrypted && !isModelicaFile(fData.cFileName)))) {
-
-                    if (stat(searchPath, &info) != 0) {
-                        printf("Error: Failed to read information of file "
-                               "\"%s\".\n",
-                               searchPath);
-                        return 0;
-                    }
+    return 1;
+}
 
-                    // Get file size.
-                    buffertSize = info.st_size;
+/*****************************************************
+ * Order files to zip: package.mo files that are
+ * encrypted by the depth of their directory, and then
+ * all files by their name in the archive.
+ ****************************************************/
+static int compareZipEntries(const void *a, const void *b)
+{
+    const ZipEntry *entryA = (const ZipEntry *)a;
+    const ZipEntry *entryB = (const ZipEntry *)b;
+    int depthA = entryA->packageDepth < 0 ? INT_MAX : entryA->packageDepth;
+    int depthB = entryB->packageDepth < 0 ? INT_MAX : entryB->packageDepth;
 
-                    // Allocate data for the whole file.
-                    if ((data = calloc((buffertSize), 1)) == NULL) {
-                        printf("Error: Failed to allocate memory for file "
-                               "\"%s\".\n",
-                               searchPath);
-                        return 0;
-                    }
+    if (depthA != depthB) {
+        return depthA < depthB ? -1 : 1;
+    }
+    return strcmp(entryA->zipPath, entryB->zipPath);
+}
 
-                    // Read the whole file to a buffer.
-                    fd = fopen(searchPath, "rb");
-                    bytes = fread(data, sizeof(char), buffertSize, fd);
-                    fclose(fd);
-
-                    if (bytes < buffertSize) {
-                        printf("Error: Failed to copy file \"%s\" to "
-                               "zip-archive.\n",
-                               searchPath);
-                        free(data);
-                        return 0;
-                    }
+/*****************************************************
+ * Read, encrypt if needed, and compress file number
+ * index of the list. The file is stored if it does
+ * not get smaller. Streamed files are left to
+ * writeStreamedZipEntry.
+ ****************************************************/
+static int compressZipEntry(void *arg, size_t index)
+{
+    ZipEntryList *list = (ZipEntryList *)arg;
+    ZipEntry *entry = &list->entries[index];
+    unsigned char *data = NULL;
+    unsigned char *encrypted = NULL;
+    size_t encryptedSize = 0;
+    void *compressed = NULL;
+    size_t compressedSize = 0;
+    FILE *fd = NULL;
 
-                    // Remove the tmp path.
-                    removeTmpFolderName(searchPath, zipPath, MAX_PATH_LENGTH);
+    if (entry->streamed) {
+        return 1;
+    }
+    if ((data = malloc(entry->size ? entry->size : 1)) == NULL) {
+        printf("Error: Failed to allocate memory for file \"%s\".\n",
+               entry->path);
+        return 0;
+    }
+    fd = fopen(entry->path, "rb");
+    if (fd == NULL || fread(data, 1, entry->size, fd) != entry->size) {
+        printf("Error: Failed to copy file \"%s\" to zip-archive.\n",
+               entry->path);
+        if (fd) {
+            fclose(fd);
+        }
+        free(data);
+        return 0;
+    }
+    fclose(fd);
 
-                    // On Windows we must change backward slash to forward slash
-                    // otherwise the zip library fails to add the file.
-                    for (index = 0; index <= (signed)strlen(zipPath); ++index) {
-                        if (zipPath[index] == '\\') {
-                            zipPath[index] = '/';
-                        }
-                    }
+    if (entry->encryptPath != NULL) {
+        encryptedSize = mlle_cr_encrypt_mem_size(list->context,
+                                                 entry->encryptPath, entry->size);
+        if ((encrypted = malloc(encryptedSize)) != NULL) {
+            encryptedSize = mlle_cr_encrypt_mem(
+                list->context, entry->encryptPath, (const char *)data,
+                entry->size, (char *)encrypted, encryptedSize);
+        } else {
+            encryptedSize = 0;
+        }
+        free(data);
+        if (encryptedSize == 0) {
+            printf("Failed to encrypt file %s.\n", entry->path);
+            free(encrypted);
+            return 0;
+        }
+        data = encrypted;
+        entry->size = encryptedSize;
+    }
+
+    entry->crc32 = mz_crc32(MZ_CRC32_INIT, data, entry->size);
+    if (entry->size > 0) {
+        compressed = tdefl_compress_mem_to_heap(
+            data, entry->size, &compressedSize,
+            tdefl_create_comp_flags_from_zip_params(ZIP_COMPRESSION_LEVEL, -15,
+                                                    MZ_DEFAULT_STRATEGY));
+    }
+    if (compressed != NULL && compressedSize < entry->size) {
+        entry->method = MZ_DEFLATED;
+        entry->data = compressed;
+        entry->dataSize = compressedSize;
+        free(data);
+    } else {
+        entry->method = 0;
+        entry->data = data;
+        entry->dataSize = entry->size;
+        free(compressed);
+    }
 
-                    // Add file to zip archive.
-                    result = mz_zip_add_mem_to_archive_file_in_place(
-                        archiveName, zipPath, data, buffertSize, comment,
-                        (mz_uint16)strlen(comment), MZ_BEST_COMPRESSION);
-
-                    if (!result) {
-                        printf("Error: Failed to add file \"%s\" to zip "
-                               "archive.\n",
-                               zipPath);
-                        free(data);
-                        return 0;
-                    }
+    return 1;
+}
+
+static void putZip16(unsigned char *p, unsigned int value)
+{
+    p[0] = (unsigned char)(value & 0xFF);
+    p[1] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+static void putZip32(unsigned char *p, unsigned long value)
+{
+    putZip16(p, (unsigned int)(value & 0xFFFF));
+    putZip16(p + 2, (unsigned int)((value >> 16) & 0xFFFF));
+}
+
+static void putZip64(unsigned char *p, unsigned long long value)
+{
+    putZip32(p, (unsigned long)(value & 0xFFFFFFFFUL));
+    putZip32(p + 4, (unsigned long)(value >> 32));
+}
+
+/*****************************************************
+ * Fill in the zip64 extra field of the local header
+ * (central == 0) or central directory header
+ * (central == 1) of a file, with the values that
+ * don't fit the header.
+ * Returns its length, 0 if it is not needed.
+ ****************************************************/
+static size_t putZip64Extra(unsigned char *extra, const ZipEntry *entry,
+                            int central)
+{
+    size_t len = 4;
+
+    // The local header has both sizes or none.
+    if (entry->zip64) {
+        putZip64(extra + len, entry->size);
+        putZip64(extra + len + 8, entry->dataSize);
+        len += 16;
+    }
+    if (central && entry->offset >= ZIP_MAX_SIZE) {
+        putZip64(extra + len, entry->offset);
+        len += 8;
+    }
+    if (len == 4) {
+        return 0;
+    }
+    putZip16(extra, 0x0001);
+    putZip16(extra + 2, (unsigned int)(len - 4));
+    return len;
+}
+
+/*****************************************************
+ * Fill in the local header (central == 0) or central
+ * directory header (central == 1) of a file, with
+ * extraLen bytes of extra field after the name.
+ ****************************************************/
+static size_t putZipHeader(unsigned char *header, const ZipEntry *entry,
+                           int central, size_t extraLen)
+{
+    unsigned char *p = header;
+    struct tm *tm = localtime(&entry->mtime);
+    unsigned int dosTime = 0;
+    unsigned int dosDate = (1 << 5) | 1; // 1980-01-01
+    unsigned int version = extraLen > 0 ? ZIP64_VERSION : ZIP_VERSION;
+
+    if (tm != NULL && tm->tm_year >= 80) {
+        dosTime = (tm->tm_hour << 11) | (tm->tm_min << 5) | (tm->tm_sec >> 1);
+        dosDate = ((tm->tm_year - 80) << 9) | ((tm->tm_mon + 1) << 5) |
+                  tm->tm_mday;
+    }
+
+    memset(header, 0, ZIP_CENTRAL_HEADER_LEN);
+    if (central) {
+        putZip32(p, 0x02014b50);
+#ifdef WIN32
+        putZip16(p + 4, version);
+#else
+        // Made on Unix, so that the file mode is kept.
+        putZip16(p + 4, (3 << 8) | version);
+#endif
+        p += 2;
+    } else {
+        putZip32(p, 0x04034b50);
+    }
+    putZip16(p + 4, version);
+    putZip16(p + 8, entry->method);
+    putZip16(p + 10, dosTime);
+    putZip16(p + 12, dosDate);
+    putZip32(p + 14, entry->crc32);
+    putZip32(p + 18, entry->zip64 ? ZIP_MAX_SIZE : (unsigned long)entry->dataSize);
+    putZip32(p + 22, entry->zip64 ? ZIP_MAX_SIZE : (unsigned long)entry->size);
+    putZip16(p + 26, (unsigned int)strlen(entry->zipPath));
+    putZip16(p + 28, (unsigned int)extraLen);
+    if (!central) {
+        return ZIP_LOCAL_HEADER_LEN;
+    }
+#ifndef WIN32
+    putZip32(p + 36, (unsigned long)(entry->mode & 0xFFFF) << 16);
+#endif
+    putZip32(p + 40, entry->offset >= ZIP_MAX_SIZE ? ZIP_MAX_SIZE
+                                                   : (unsigned long)entry->offset);
+    return ZIP_CENTRAL_HEADER_LEN;
+}
+
+/*****************************************************
+ * Length of the local header of a file, with its
+ * name and extra field.
+ ****************************************************/
+static size_t zipLocalHeaderLen(const ZipEntry *entry)
+{
+    unsigned char extra[ZIP64_EXTRA_MAX_LEN];
+
+    return ZIP_LOCAL_HEADER_LEN + strlen(entry->zipPath) +
+           putZip64Extra(extra, entry, 0);
+}
+
+/*****************************************************
+ * Write a header, the name and the extra field of a
+ * file. Returns the number of bytes written, or 0 on
+ * failure.
+ ****************************************************/
+static size_t writeZipHeader(FILE *out, const ZipEntry *entry, int central)
+{
+    unsigned char header[ZIP_CENTRAL_HEADER_LEN];
+    unsigned char extra[ZIP64_EXTRA_MAX_LEN];
+    size_t extraLen = putZip64Extra(extra, entry, central);
+    size_t len = putZipHeader(header, entry, central, extraLen);
+    size_t nameLen = strlen(entry->zipPath);
+
+    if (fwrite(header, 1, len, out) != len ||
+        fwrite(entry->zipPath, 1, nameLen, out) != nameLen ||
+        fwrite(extra, 1, extraLen, out) != extraLen) {
+        return 0;
+    }
+    return len + nameLen + extraLen;
+}
+
+/*****************************************************
+ * Write the end of central directory record, and
+ * before it the zip64 end record and locator if the
+ * count, size or offset of the central directory
+ * don't fit it.
+ ****************************************************/
+static int writeZipEnd(FILE *out, size_t count, unsigned long long centralOffset,
+                       unsigned long long centralLen)
+{
+    unsigned char end[ZIP64_END_LEN + ZIP64_LOCATOR_LEN + ZIP_END_LEN];
+    unsigned char *p = end;
+    int zip64 = count >= ZIP_MAX_COUNT || centralOffset >= ZIP_MAX_SIZE ||
+                centralLen >= ZIP_MAX_SIZE;
+
+    memset(end, 0, sizeof(end));
+    if (zip64) {
+        putZip32(p, 0x06064b50);
+        putZip64(p + 4, ZIP64_END_LEN - 12);
+        putZip16(p + 12, ZIP64_VERSION);
+        putZip16(p + 14, ZIP64_VERSION);
+        putZip64(p + 24, count);
+        putZip64(p + 32, count);
+        putZip64(p + 40, centralLen);
+        putZip64(p + 48, centralOffset);
+        p += ZIP64_END_LEN;
+
+        // The zip64 end record starts right after the central directory.
+        putZip32(p, 0x07064b50);
+        putZip64(p + 8, centralOffset + centralLen);
+        putZip32(p + 16, 1);
+        p += ZIP64_LOCATOR_LEN;
+    }
+    putZip32(p, 0x06054b50);
+    putZip16(p + 8, zip64 ? ZIP_MAX_COUNT : (unsigned int)count);
+    putZip16(p + 10, zip64 ? ZIP_MAX_COUNT : (unsigned int)count);
+    putZip32(p + 12, zip64 ? ZIP_MAX_SIZE : (unsigned long)centralLen);
+    putZip32(p + 16, zip64 ? ZIP_MAX_SIZE : (unsigned long)centralOffset);
+    p += ZIP_END_LEN;
+
+    return fwrite(end, 1, (size_t)(p - end), out) == (size_t)(p - end);
+}
+
+/*****************************************************
+ * Seek to an absolute offset in the zip archive, or
+ * get the offset of a file, which may be past 2 GB.
+ ****************************************************/
+static int seekZip(FILE *out, unsigned long long offset)
+{
+#ifdef WIN32
+    return _fseeki64(out, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(out, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static unsigned long long tellZip(FILE *in)
+{
+#ifdef WIN32
+    return (unsigned long long)_ftelli64(in);
+#else
+    return (unsigned long long)ftello(in);
+#endif
+}
+
+// Where tdefl_compress_buffer writes a streamed file. Compressing
+// stops when the data would get longer than limit.
+typedef struct {
+    FILE *out;
+    unsigned long long len;
+    unsigned long long limit;
+    int tooLong;
+} ZipOutput;
+
+static mz_bool putZipOutput(const void *buf, int len, void *user)
+{
+    ZipOutput *output = (ZipOutput *)user;
+
+    if (output->len + (unsigned long long)len > output->limit) {
+        output->tooLong = 1;
+        return MZ_FALSE;
+    }
+    output->len += (unsigned long long)len;
+    return fwrite(buf, 1, (size_t)len, output->out) == (size_t)len;
+}
+
+/*****************************************************
+ * Write a file that is too large to compress in
+ * memory at the end of the archive, compressing it
+ * ZIP_CHUNK_LEN bytes at a time. The local header is
+ * filled in when the CRC and sizes are known. A file
+ * that is encrypted is first encrypted to a temporary
+ * file. As in compressZipEntry, the file is stored if
+ * it does not get smaller, over the compressed data,
+ * which is never written past the length of the file.
+ ****************************************************/
+static int writeStreamedZipEntry(FILE *out, ZipEntryList *list,
+                                 ZipEntry *entry)
+{
+    tdefl_compressor *compressor = NULL;
+    unsigned char *buffer = NULL;
+    ZipOutput output;
+    FILE *in = NULL;
+    FILE *spill = NULL;
+    size_t bytes = 0;
+    unsigned long long dataOffset = 0;
+    unsigned long long expectedSize = 0;
+    tdefl_status status = TDEFL_STATUS_OKAY;
+    int result = 0;
+
+    in = fopen(entry->path, "rb");
+    if (in == NULL) {
+        printf("Error: Failed to copy file \"%s\" to zip-archive.\n",
+               entry->path);
+        goto error;
+    }
+    if (entry->encryptPath != NULL) {
+        spill = tmpfile();
+        if (spill == NULL ||
+            !mlle_cr_encrypt(list->context, entry->encryptPath, in, spill)) {
+            printf("Failed to encrypt file %s.\n", entry->path);
+            goto error;
+        }
+        fclose(in);
+        in = spill;
+        spill = NULL;
+        entry->size = (size_t)tellZip(in);
+        rewind(in);
+    }
+
+    compressor = (tdefl_compressor *)malloc(sizeof(tdefl_compressor));
+    buffer = (unsigned char *)malloc(ZIP_CHUNK_LEN);
+    if (compressor == NULL || buffer == NULL) {
+        printf("Error: Failed to allocate memory for file \"%s\".\n",
+               entry->path);
+        goto error;
+    }
+
+    // A placeholder for the header, and then the compressed data. The
+    // data is never longer than the file, so its size decides if the
+    // header needs zip64 sizes.
+    expectedSize = entry->size;
+    entry->zip64 = entry->size >= ZIP_MAX_SIZE;
+    entry->method = MZ_DEFLATED;
+    entry->crc32 = MZ_CRC32_INIT;
+    entry->size = 0;
+    entry->dataSize = 0;
+    if (!writeZipHeader(out, entry, 0)) {
+        goto writeError;
+    }
+    dataOffset = entry->offset + zipLocalHeaderLen(entry);
+    output.out = out;
+    output.len = 0;
+    output.limit = expectedSize > 0 ? expectedSize - 1 : 0;
+    output.tooLong = 0;
+    tdefl_init(compressor, putZipOutput, &output,
+               tdefl_create_comp_flags_from_zip_params(
+                   ZIP_COMPRESSION_LEVEL, -15, MZ_DEFAULT_STRATEGY));
+    do {
+        bytes = fread(buffer, 1, ZIP_CHUNK_LEN, in);
+        if (ferror(in)) {
+            printf("Error: Failed to copy file \"%s\" to zip-archive.\n",
+                   entry->path);
+            goto error;
+        }
+        entry->crc32 = mz_crc32(entry->crc32, buffer, bytes);
+        entry->size += bytes;
+        status = tdefl_compress_buffer(
+            compressor, buffer, bytes,
+            bytes < ZIP_CHUNK_LEN ? TDEFL_FINISH : TDEFL_NO_FLUSH);
+    } while (bytes == ZIP_CHUNK_LEN && status == TDEFL_STATUS_OKAY);
+    if (status != TDEFL_STATUS_DONE && !output.tooLong) {
+        goto writeError;
+    }
+    entry->dataSize = (size_t)output.len;
+
+    if (output.tooLong || entry->dataSize >= entry->size) {
+        entry->method = 0;
+        entry->crc32 = MZ_CRC32_INIT;
+        entry->size = 0;
+        rewind(in);
+        if (!seekZip(out, dataOffset)) {
+            goto writeError;
+        }
+        while ((bytes = fread(buffer, 1, ZIP_CHUNK_LEN, in)) > 0) {
+            if (fwrite(buffer, 1, bytes, out) != bytes) {
+                goto writeError;
+            }
+            entry->crc32 = mz_crc32(entry->crc32, buffer, bytes);
+            entry->size += bytes;
+        }
+        // A file that got shorter would leave compressed data behind.
+        if (ferror(in) || entry->size < output.len) {
+            printf("Error: Failed to copy file \"%s\" to zip-archive.\n",
+                   entry->path);
+            goto error;
+        }
+        entry->dataSize = entry->size;
+    }
+
+    if (!entry->zip64 && entry->size >= ZIP_MAX_SIZE) {
+        printf("Error: File \"%s\" grew while it was zipped.\n", entry->path);
+        goto error;
+    }
+
+    // Fill in the header, and continue after the data.
+    if (!seekZip(out, entry->offset) || !writeZipHeader(out, entry, 0) ||
+        !seekZip(out, dataOffset + entry->dataSize)) {
+        goto writeError;
+    }
+
+    result = 1;
+    goto error;
+
+writeError:
+    printf("Error: Failed to write file \"%s\" to zip archive.\n",
+           entry->zipPath);
+error:
+    if (in) {
+        fclose(in);
+    }
+    if (spill) {
+        fclose(spill);
+    }
+    free(buffer);
+    free(compressor);
+    return result;
+}
+
+int writeZipArchive(char *archiveName, ZipEntryList *list, int nThreads)
+{
+    FILE *out = NULL;
+    ThreadWork work;
+    ZipEntry *entry;
+    unsigned long long offset = 0;
+    unsigned long long centralOffset = 0;
+    size_t begin, stop, i, batchLen, len;
+    int result = 0;
+
+    memset(&work, 0, sizeof(work));
+    work.work = compressZipEntry;
+    work.arg = list;
+    work.mutex = mlle_mutex_new();
+    if (work.mutex == NULL) {
+        printf("Error: Failed to allocate memory for compressing files.\n");
+        goto error;
+    }
+    if ((out = fopen(archiveName, "wb")) == NULL) {
+        printf("Error: Failed to open zip archive \"%s\": %s\n", archiveName,
+               strerror(errno));
+        goto error;
+    }
+
+    for (begin = 0; begin < list->count; begin = stop) {
+        // Compress a batch of files on all threads, and then write it,
+        // so that only that batch is kept in memory. The package.mo files
+        // that are encrypted make up batches of their own, a directory level
+        // at a time, since each one needs the key mask of the one above.
+        // Streamed files are not in memory, and don't count.
+        batchLen = 0;
+        stop = begin;
+        while (stop < list->count &&
+               list->entries[stop].packageDepth == list->entries[begin].packageDepth &&
+               (stop == begin || list->entries[stop].streamed ||
+                batchLen + list->entries[stop].size <= ZIP_BATCH_LEN)) {
+            batchLen += list->entries[stop].streamed ? 0 : list->entries[stop].size;
+            stop++;
+        }
+        if (!runOnThreads(&work, begin, stop, nThreads)) {
+            goto error;
+        }
+
+        for (i = begin; i < stop; i++) {
+            entry = &list->entries[i];
+            entry->offset = offset;
+            if (entry->streamed) {
+                if (!writeStreamedZipEntry(out, list, entry)) {
+                    goto error;
+                }
+            } else {
+                entry->zip64 = entry->size >= ZIP_MAX_SIZE ||
+                               entry->dataSize >= ZIP_MAX_SIZE;
+                if (!writeZipHeader(out, entry, 0) ||
+                    fwrite(entry->data, 1, entry->dataSize, out) !=
+                        entry->dataSize) {
+                    printf("Error: Failed to write file \"%s\" to zip "
+                           "archive \"%s\".\n",
+                           entry->zipPath, archiveName);
+                    goto error;
+                }
+            }
+            free(entry->data);
+            entry->data = NULL;
+            offset += zipLocalHeaderLen(entry) + entry->dataSize;
+        }
+    }
+
+    // The central directory, and its end record.
+    centralOffset = offset;
+    for (i = 0; i < list->count; i++) {
+        entry = &list->entries[i];
+        if ((len = writeZipHeader(out, entry, 1)) == 0) {
+            printf("Error: Failed to write zip archive \"%s\".\n", archiveName);
+            goto error;
+        }
+        offset += len;
+    }
+    if (!writeZipEnd(out, list->count, centralOffset, offset - centralOffset) ||
+        fclose(out) != 0) {
+        out = NULL;
+        printf("Error: Failed to write zip archive \"%s\".\n", archiveName);
+        goto error;
+    }
+    out = NULL;
+    result = 1;
+
+error:
+    if (out) {
+        fclose(out);
+    }
+    mlle_mutex_free(work.mutex);
+    return result;
+}
+
+/*****************************
+ * Create a zipped archive.
+ ****************************/
+int createZipArchive()
+{
+    int result = 0;
+    char *cwd = NULL;
+    char archiveName[MAX_STRING] = {'\0'};
+    char pathToZipfile[MAX_PATH_LENGTH] = {'\0'};
+    int encrypted = 0;
+    ZipEntryList list = {NULL, 0, 0, NULL};
+    size_t i;
+
+    // Get last folder name in library path. This will
+    // be the name of the archive.
+    snprintf(archiveName, MAX_STRING, "%s.mol", getLibraryName());
+
+    // Is library encrypted. If so, don't put the .mo-files in the archive.
+    if (usingEncryption()) {
+        encrypted = 1;
+    }
+
+    // Get current directory.
+    if (getCurrentDirectory(&cwd)) {
+        snprintf(pathToZipfile, MAX_PATH_LENGTH, "%s/%s", cwd, archiveName);
+
+        // Remove any previous zip-file.
+        if (fileExists(pathToZipfile)) {
+            remove(pathToZipfile);
+        }
+    }
+
+    // When streaming, the staging folder only has the .library folder,
+    // and the files of the library are read from the library path. The
+    // .mo-files are then encrypted as they are zipped.
+    if (usingStreaming() && encrypted) {
+        list.context = mlle_cr_create(getValueOf(ARGUMENT_LIBRARY_PATH));
+        if (NULL == list.context) {
+            printf("Could not allocated memory for encryption context\n");
+            return 0;
+        }
+        if (!mlle_cr_set_format(list.context, getEncryptionFormat())) {
+            printf("Encryption format is not supported by the decryptor\n");
+            goto error;
+        }
+    }
+
+#ifdef WIN32
+    result = findFilesToZipWin32(getTempStagingDirectory(), "", encrypted, &list);
+    if (result && usingStreaming()) {
+        result = findFilesToZipWin32(getValueOf(ARGUMENT_LIBRARY_PATH),
+                                     getLibraryName(), 0, &list);
+    }
+#else
+    result = findFilesToZipLinux(getTempStagingDirectory(), "", encrypted, &list);
+    if (result && usingStreaming()) {
+        result = findFilesToZipLinux(getValueOf(ARGUMENT_LIBRARY_PATH),
+                                     getLibraryName(), 0, &list);
+    }
+#endif
+    if (result) {
+        // Sort the files, so that the archive does not depend on the order
+        // the directories list them in.
+        qsort(list.entries, list.count, sizeof(ZipEntry), compareZipEntries);
+        result = writeZipArchive(archiveName, &list, getThreadCount());
+    }
+
+error:
+    for (i = 0; i < list.count; i++) {
+        free(list.entries[i].path);
+        free(list.entries[i].zipPath);
+        free(list.entries[i].encryptPath);
+        free(list.entries[i].data);
+    }
+    free(list.entries);
+    mlle_cr_free(list.context);
+    return result;
+}
+
+/******************************************************
+ * Find the files to zip in a directory on Windows.
+ *****************************************************/
+int findFilesToZipWin32(char *path, const char *zipPath, int encrypted,
+                        ZipEntryList *list)
+{
+    int result = 1;
+#ifdef WIN32
+    WIN32_FIND_DATA fData;
+    HANDLE hFind = NULL;
+    char searchPath[MAX_PATH_LENGTH];
+    char entryPath[MAX_PATH_LENGTH];
+    int modelica = 0;
+
+    // Find all.
+    snprintf(searchPath, MAX_PATH_LENGTH, "%s\\*.*", path);
+
+    // Try to find file in top-level directory.
+    if ((hFind = FindFirstFile(searchPath, &fData)) == INVALID_HANDLE_VALUE) {
+        printf("Error creating archive starting from \"%s\".\n", path);
+        return 0;
+    }
+
+    do {
+        // The first two directories are always "." and "..".
+        if (strcmp(fData.cFileName, ".") != 0 &&
+            strcmp(fData.cFileName, "..") != 0) {
+            // Build up our file path using the passed in
+            // [path] and the file/foldername we just found:
+            snprintf(searchPath, MAX_PATH_LENGTH, "%s\\%s", path,
+                     fData.cFileName);
+            // And its path in the archive.
+            snprintf(entryPath, MAX_PATH_LENGTH, "%s%s%s", zipPath,
+                     *zipPath ? "/" : "", fData.cFileName);
+
+            // Have we found a folder?
+            if (fData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                // Use recursive to check the folder we found.
+                result = findFilesToZipWin32(searchPath, entryPath, encrypted,
+                                             list);
+            }
 
-                    free(data);
+            // Or a regular file?
+            else if (fData.dwFileAttributes) {
+                // -------------------------------------------------------------
+                // Only add file to archive when:
+                // 1. Files are not encrypted.
+                // 2. Files are encrypted and the file is not a Modelica file.
+                // -------------------------------------------------------------
+                modelica = isModelicaFile(fData.cFileName);
+                if ((!encrypted) || ((encrypted && !modelica))) {
+                    result = addZipEntry(list, searchPath, entryPath,
+                                         modelica && list->context != NULL);
                 }
             }
         }
-    } while (FindNextFile(hFind, &fData)); // Find the next file
+    } while (result && FindNextFile(hFind, &fData)); // Find the next file
 
     FindClose(hFind);
+#else
+    (void) path;
+    (void) zipPath;
+    (void) encrypted;
+    (void) list;
 #endif
 
     return result;
 }
 
 /******************************************************
- * Creates a zipped archive of a directory on Linux.
+ * Find the files to zip in a directory on Linux.
  *****************************************************/
-int zipDirectoryLinux(struct zip_t *zip, char *path, char *archiveName,
-                      int encrypted)
+int findFilesToZipLinux(char *path, const char *zipPath, int encrypted,
+                        ZipEntryList *list)
 {
     int result = 0;
-    int status = 0;
 
 #if defined linux || defined DARWIN
     DIR *d;
     struct dirent *dir;
     char searchPath[MAX_PATH_LENGTH + 1];
-    char zipPath[MAX_PATH_LENGTH + 1] = {'\0'};
+    char entryPath[MAX_PATH_LENGTH + 1];
+    int modelica = 0;
 
     // Find all.
     snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s", path);
-    // printf("**** searchPath %s\n", searchPath);
 
     if ((d = opendir(searchPath))) {
         result = 1; // return 'success' for empty directory
-        while ((dir = readdir(d)) != NULL) {
+        while (result && (dir = readdir(d)) != NULL) {
             // The first two directories are always "." and "..".
             if (strcmp(dir->d_name, ".") != 0 &&
                 strcmp(dir->d_name, "..") != 0) {
@@ -1531,17 +2287,15 @@ int zipDirectoryLinux(struct zip_t *zip, char *path, char *archiveName,
                     snprintf(searchPath, MAX_PATH_LENGTH + 1, "%s/%s", path,
                              dir->d_name);
                 }
-
-                // printf("zip: searchpath: %s\n", searchPath);
+                // And its path in the archive.
+                snprintf(entryPath, MAX_PATH_LENGTH + 1, "%s%s%s", zipPath,
+                         *zipPath ? "/" : "", dir->d_name);
 
                 // Have we found a folder?
                 if (dir->d_type == DT_DIR) {
                     // Use recursive to check the folder we found.
-                    result = zipDirectoryLinux(zip, searchPath, archiveName,
-                                               encrypted);
-                    if (1 != result) {
-                        break;
-                    }
+                    result = findFilesToZipLinux(searchPath, entryPath,
+                                                 encrypted, list);
                 }
                 // Or a file?
                 else if (dir->d_type == DT_REG) {
@@ -1551,23 +2305,10 @@ int zipDirectoryLinux(struct zip_t *zip, char *path, char *archiveName,
                     // 2. Files are encrypted and the file is not a Modelica
                     // file(.mo).
                     // -----------------------------------------------------------------
-                    // printf("Filename: %s, encrypted: %d\n", dir->d_name,
-                    // encrypted);
-
-                    if ((!encrypted) ||
-                        ((encrypted && !isModelicaFile(dir->d_name)))) {
-
-                        // Remove the tmp path.
-                        removeTmpFolderName(searchPath, zipPath,
-                                            MAX_PATH_LENGTH);
-
-                        // Add file to zip archive.
-                        status = addFileToZipArchive(zip, archiveName, zipPath,
-                                                     searchPath);
-                        result = (1 == status);
-                        if (1 != result) {
-                            break;
-                        }
+                    modelica = isModelicaFile(dir->d_name);
+                    if ((!encrypted) || ((encrypted && !modelica))) {
+                        result = addZipEntry(list, searchPath, entryPath,
+                                             modelica && list->context != NULL);
                     }
                 }
             }
@@ -1600,6 +2341,27 @@ int cleanUpIconPath()
 
     tmpBuf = pathToIcon;
 
+    // When streaming, the icon was found in the library path, so replace
+    // that with the library name.
+    if (usingStreaming()) {
+        ptr1 = tmpBuf + strlen(getValueOf(ARGUMENT_LIBRARY_PATH));
+        if (*ptr1 == '/' || *ptr1 == '\\') {
+            ++ptr1;
+        }
+        path_len = strlen(getLibraryName()) + strlen(ptr1) + 2;
+        pathToIcon = malloc(path_len);
+        snprintf(pathToIcon, path_len, "%s/%s", getLibraryName(), ptr1);
+
+        // replace '\\' with '/' according to spec
+        for (i = 0; pathToIcon[i]; i++) {
+            if (pathToIcon[i] == '\\') {
+                pathToIcon[i] = '/';
+            }
+        }
+        free(tmpBuf);
+        return 1;
+    }
+
 // Get the tmp path.
 #ifdef WIN32
     tmpDir = getenv("TEMP");
@@ -1649,110 +2411,60 @@ int cleanUpIconPath()
     return 0;
 }
 
-/*****************************************************
- * Remove the temp folder path from icon file path.
- * This is done before adding files to zip file.
- ****************************************************/
-int removeTmpFolderName(char *searchPath, char *zipPath, size_t zipPathLen)
+/***********************************************
+ * Check if encryption of files is activated.
+ **********************************************/
+int usingEncryption()
 {
-    char *tmpDir = NULL;
-    char *ptr = NULL;
-
-    tmpDir = getTempStagingDirectory();
-
-    // Clear the array.
-    memset(&zipPath[0], 0, strlen(zipPath));
-
-    ptr = searchPath;
-    ptr += strlen(tmpDir) + 1;
-
-    if (ptr && *ptr) {
-        snprintf(zipPath, zipPathLen, "%s", ptr);
-    }
+    char *value = getValueOf(ARGUMENT_ENCRYPT);
 
-    return 1;
+    // Is encryption activated?
+    return (containsKey(ARGUMENT_ENCRYPT) &&
+            (strcmp(stringToLower(value), "true") == 0));
 }
 
-int openZipArchive(struct zip_t **zip, char *archiveName)
+/***********************************************
+ * Check if streaming is activated.
+ **********************************************/
+int usingStreaming()
 {
-    int result = 0;
-    int status = 0;
-#ifdef WIN32
-#else
-    const int SEMLA_ZIP_BEST_COMPRESSION_LEVEL = 9;
-    *zip = zip_openwitherror(archiveName, SEMLA_ZIP_BEST_COMPRESSION_LEVEL, 'w',
-                             &status);
-    if (*zip == NULL) {
-        printf("Error: Failed to open zip archive \"%s\". Zip Library Error: "
-               "\"%s\"\n",
-               archiveName, zip_strerror(status));
-        goto error;
-    }
-    result = 1;
-#endif
-error:
-    return result;
-}
+    char *value = getValueOf(ARGUMENT_STREAM);
 
-void closeZipArchive(struct zip_t *zip)
-{
-#ifdef WIN32
-#else
-    if (zip != NULL) {
-        zip_close(zip);
-    }
-#endif
+    return (containsKey(ARGUMENT_STREAM) &&
+            (strcmp(stringToLower(value), "true") == 0));
 }
 
-int addFileToZipArchive(struct zip_t *zip, char *archiveName, char *zipPath,
-                        char *searchPath)
+int getEncryptionFormat()
 {
-    int result = 0;
-    int status = 0;
+    char *value = getValueOf(ARGUMENT_ENCRYPTION_FORMAT);
 
-#ifdef WIN32
-#else
-    status = zip_entry_open(zip, zipPath);
-    if (status < 0) {
-        printf("Error: Failed to open zip archive entry \"%s\" (when trying to "
-               "add input file \"%s\" to "
-               "zip archive \"%s\"). Zip Library Error: \"%s\"\n",
-               zipPath, searchPath, archiveName, zip_strerror(status));
-        goto error;
+    if (!containsKey(ARGUMENT_ENCRYPTION_FORMAT) ||
+        (strcmp(stringToLower(value), "cbc") == 0)) {
+        return MLLE_CR_FORMAT_CBC_HMAC;
     }
-    status = zip_entry_fwrite(zip, searchPath);
-    if (status < 0) {
-        printf("Error: Failed to write input file \"%s\" to "
-               " zip archive entry \"%s\" in zip archive \"%s\". Zip Library "
-               "Error: \"%s\"\n",
-               searchPath, zipPath, archiveName, zip_strerror(status));
-        goto error;
+    if (strcmp(stringToLower(value), "gcm") == 0) {
+        return MLLE_CR_FORMAT_GCM;
     }
-    status = zip_entry_close(zip);
-    if (status < 0) {
-        printf(
-            "Error: Failed to close zip archive entry \"%s\" (when trying to "
-            "add input file \"%s\" to "
-            "zip archive \"%s\"). Zip Library Error: \"%s\"\n",
-            zipPath, searchPath, archiveName, zip_strerror(status));
-        goto error;
+    if (strcmp(stringToLower(value), "chunked") == 0) {
+        return MLLE_CR_FORMAT_GCM_CHUNKED;
     }
-    result = 1;
-#endif
-error:
-    return result;
+    return 0;
 }
 
-/***********************************************
- * Check if encryption of files is activated.
- **********************************************/
-int usingEncryption()
+int getThreadCount()
 {
-    char *value = getValueOf(ARGUMENT_ENCRYPT);
+    char *value = getValueOf(ARGUMENT_THREADS);
+    char *end = NULL;
+    long count;
 
-    // Is encryption activated?
-    return (containsKey(ARGUMENT_ENCRYPT) &&
-            (strcmp(stringToLower(value), "true") == 0));
+    if (!containsKey(ARGUMENT_THREADS)) {
+        return mlle_thread_cpu_count();
+    }
+    count = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || count < 1 || count > INT_MAX) {
+        return 0;
+    }
+    return (int)count;
 }
 
 int createStagingFolder()
@@ -1818,6 +2530,7 @@ int stageFiles(char *copyFromPath, char *copyToPath)
 int copyFolderStructure()
 {
     char *copyFromPath = NULL;
+    char dotLibrary[MAX_PATH_LENGTH];
     int status = 1;
 
     if (getTempStagingDirectory() == NULL) {
@@ -1839,6 +2552,18 @@ int copyFolderStructure()
         goto out;
     }
 
+    // When streaming, only the .library folder is made in the staging
+    // folder, so the library must not have one of its own.
+    if (usingStreaming()) {
+        snprintf(dotLibrary, MAX_PATH_LENGTH, "%s/.library", copyFromPath);
+        if (fileExists(dotLibrary)) {
+            printf("Error: The library already has a .library folder (%s)\n",
+                   dotLibrary);
+            status = 0;
+        }
+        goto out;
+    }
+
     if (!stageFiles(copyFromPath, getCopiedSourcePath())) {
         printf("Failed to perform staging of files\n");
         status = 0;
@@ -1858,21 +2583,12 @@ int copyDirectoryWin32(char *fromPath, char *toPath)
     int result = 1;
 
 #ifdef WIN32
-    struct stat info;
-    int buffSize = 0;
-    size_t bytes = 0;
-    char *data = NULL;
-    FILE *fdRead = NULL;
-    FILE *fdWrite = NULL;
-
     WIN32_FIND_DATA fdFile;
     HANDLE hFind = NULL;
     char searchPath[MAX_PATH_LENGTH];
     char searchPathTo[MAX_PATH_LENGTH];
-    char folderName[MAX_PATH_LENGTH];
 
     // Find all.
-    // TODO add check and increase memory if necessary.
     snprintf(searchPath, MAX_PATH_LENGTH, "%s\\*.*", fromPath);
 
     // Try to find file in top-level directory.
@@ -1891,65 +2607,28 @@ int copyDirectoryWin32(char *fromPath, char *toPath)
             // [path] and the file/foldername we just found:
             snprintf(searchPath, MAX_PATH_LENGTH, "%s\\%s", fromPath,
                      fdFile.cFileName);
+            _snprintf(searchPathTo, MAX_PATH_LENGTH, "%s\\%s", toPath,
+                      fdFile.cFileName);
 
             // Have we found a folder?
             if (fdFile.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-                _snprintf(searchPathTo, MAX_PATH_LENGTH, "%s\\%s", toPath,
-                          fdFile.cFileName);
-                // TODO Create folder name.
-
                 if (_mkdir(searchPathTo) == -1) {
                     printf("Error: Failed to create folder %s.\n",
                            searchPathTo);
+                    result = 0;
+                    continue;
                 }
 
                 // Use recursive to check the folder we found.
-                copyDirectoryWin32(searchPath, searchPathTo);
+                result = copyDirectoryWin32(searchPath, searchPathTo);
             }
 
             // Or a regular file?
             else if (fdFile.dwFileAttributes) {
-                {
-                    fdRead = fopen(searchPath, "rb");
-
-                    if (stat(searchPath, &info) != 0) {
-                        printf("Error: Failed to read information of file "
-                               "\"%s\".\n",
-                               searchPath);
-                        return 0;
-                    }
-                    // Get file size.
-                    buffSize = info.st_size;
-
-                    // Allocate data for the whole file.
-                    if ((data = calloc((buffSize + 1), 1)) == NULL) {
-                        printf("Error: Failed to allocate memory for file "
-                               "\"%s\".\n",
-                               searchPath);
-                        return 0;
-                    }
-
-                    // Read the whole file to a buffer.
-                    bytes = fread(data, sizeof(char), buffSize, fdRead);
-
-                    // Write to file in new location.
-                    if (_snprintf(folderName, MAX_PATH_LENGTH, "%s\\%s", toPath,
-                                  fdFile.cFileName) == -1) {
-                        printf("Not enough memory to create folder path %s.\n",
-                               toPath);
-                        return 0;
-                    }
-
-                    fdWrite = fopen(folderName, "wb");
-                    fwrite(data, sizeof(char), buffSize, fdWrite);
-
-                    fclose(fdRead);
-                    fclose(fdWrite);
-                    free(data);
-                }
+                result = copyFile(searchPath, searchPathTo);
             }
         }
-    } while (FindNextFile(hFind, &fdFile)); // Find the next file
+    } while (result && FindNextFile(hFind, &fdFile)); // Find the next file
 
     FindClose(hFind);
 
@@ -1966,13 +2645,7 @@ int copyDirectoryLinux(char *fromPath, char *toPath)
     int result = 1;
 #if defined linux || defined DARWIN
     DIR *d;
-    struct stat info;
     struct dirent *dir;
-    char *data = NULL;
-    int bytes = 0;
-    long buffSize = 0;
-    FILE *fdRead = NULL;
-    FILE *fdWrite = NULL;
     char searchPath[MAX_PATH_LENGTH];
     char searchPathTo[MAX_PATH_LENGTH];
     char folderName[MAX_PATH_LENGTH];
@@ -1980,10 +2653,8 @@ int copyDirectoryLinux(char *fromPath, char *toPath)
     // Find all.
     snprintf(searchPath, MAX_PATH_LENGTH, "%s", fromPath);
 
-    // printf("searchPath: %s\n", searchPath);
-
     if ((d = opendir(searchPath))) {
-        while ((dir = readdir(d)) != NULL) {
+        while (result && (dir = readdir(d)) != NULL) {
             // The first two directories are always "." and "..".
             if (strcmp(dir->d_name, ".") != 0 &&
                 strcmp(dir->d_name, "..") != 0 &&
@@ -2003,24 +2674,22 @@ int copyDirectoryLinux(char *fromPath, char *toPath)
 
                     snprintf(searchPathTo, MAX_PATH_LENGTH, "%s/%s", toPath,
                              dir->d_name);
-                    // TODO Create folder name.
 
                     if (mkdir(searchPathTo, 0777) == -1) {
-                        printf("Error: Failed to create folder %s.\n",
-                               searchPathTo);
+                        printf("Error: Failed to create folder %s: %s\n",
+                               searchPathTo, strerror(errno));
+                        result = 0;
+                        continue;
                     }
 
                     // Use recursive to check the folder we found.
-                    copyDirectoryLinux(searchPath, searchPathTo);
+                    result = copyDirectoryLinux(searchPath, searchPathTo);
                 }
                 // Or a file?
                 else if (dir->d_type == DT_REG) {
-                    // printf("Filnamn: %s\n", dir->d_name);
-
                     // file in new location.
                     snprintf(folderName, MAX_PATH_LENGTH, "%s/%s", toPath, dir->d_name);
-                    copyFile(searchPath, folderName);
-
+                    result = copyFile(searchPath, folderName);
                 }
             }
         }
@@ -2034,14 +2703,98 @@ int copyDirectoryLinux(char *fromPath, char *toPath)
     return result;
 }
 
+#ifndef WIN32
+/*****************************************
+ * Check if a failed copy_file_range or sendfile only means that the
+ * method can't be used for these files, so that the next one is tried.
+ ****************************************/
+static int copyMethodUnsupported(int error)
+{
+    return error == ENOSYS || error == EXDEV || error == EINVAL ||
+           error == EOPNOTSUPP || error == ENOTSUP;
+}
+
+/*****************************************
+ * Copy the data of file descriptor in to out, both at offset 0.
+ * Tries, in order, to share the data with a reflink (FICLONE), to copy
+ * it in the kernel with copy_file_range or sendfile, and to copy it
+ * through a COPY_BUFFER_LEN buffer. Each method continues where the
+ * previous one stopped.
+ * Returns 1 on success, 0 otherwise.
+ ****************************************/
+static int copyFileData(int in, int out, off_t size)
+{
+    int result = 0;
+    char *buffer = NULL;
+    off_t copied = 0;
+    ssize_t bytes = 0;
+    ssize_t written = 0;
+    ssize_t done = 0;
+
+#ifdef FICLONE
+    if (ioctl(out, FICLONE, in) == 0) {
+        return 1;
+    }
+#endif
+
+#if defined linux
+    while (copied < size &&
+           (bytes = copy_file_range(in, NULL, out, NULL,
+                                    (size_t)(size - copied), 0)) > 0) {
+        copied += bytes;
+    }
+    if (bytes < 0 && !copyMethodUnsupported(errno)) {
+        goto error;
+    }
+    if (bytes == 0 && copied > 0) {
+        // The file got shorter while copying.
+        return 1;
+    }
+
+    bytes = 1;
+    while (copied < size &&
+           (bytes = sendfile(out, in, NULL, (size_t)(size - copied))) > 0) {
+        copied += bytes;
+    }
+    if (bytes < 0 && !copyMethodUnsupported(errno)) {
+        goto error;
+    }
+    if (bytes == 0) {
+        return 1;
+    }
+#endif
+
+    if (copied < size) {
+        if ((buffer = malloc(COPY_BUFFER_LEN)) == NULL) {
+            errno = ENOMEM;
+            goto error;
+        }
+        while ((bytes = read(in, buffer, COPY_BUFFER_LEN)) > 0) {
+            for (written = 0; written < bytes; written += done) {
+                done = write(out, buffer + written, bytes - written);
+                if (done < 0) {
+                    goto error;
+                }
+            }
+        }
+        if (bytes < 0) {
+            goto error;
+        }
+    }
+
+    result = 1;
+error:
+    free(buffer);
+    return result;
+}
+#endif
+
 int copyFile(char *fromPath, char *toPath)
 {
     int result = 0;
-    int status = 0;
-    struct stat info;
+#ifdef WIN32
     char *data = NULL;
-    int bytes = 0;
-    long buffSize = 0;
+    size_t bytes = 0;
     FILE *fdRead = NULL;
     FILE *fdWrite = NULL;
 
@@ -2052,47 +2805,70 @@ int copyFile(char *fromPath, char *toPath)
         goto error;
     }
 
-    if (stat(fromPath, &info) != 0) {
-        printf("Error: Failed to read information of file "
-               "\"%s\".\n",
-               fromPath);
+    fdWrite = fopen(toPath, "wb");
+    if (fdWrite == NULL) {
+        printf(
+            "Error: When copying file: Could not open output file \"%s\": %s",
+            toPath, strerror(errno));
         goto error;
     }
 
-    // Get file size.
-    buffSize = info.st_size;
-
-    // Allocate data for the whole file.
-    if ((data = calloc((buffSize + 1), 1)) == NULL) {
+    if ((data = malloc(COPY_BUFFER_LEN)) == NULL) {
         printf("Error: When copying file: Failed to allocate memory for file "
                "\"%s\".\n",
                fromPath);
         goto error;
     }
 
-    // Read the whole file to a buffer.
-    bytes = fread(data, sizeof(char), buffSize, fdRead);
-    if (bytes != buffSize) {
+    // Copy a buffer at a time, to not hold large files in memory.
+    while ((bytes = fread(data, sizeof(char), COPY_BUFFER_LEN, fdRead)) > 0) {
+        if (fwrite(data, sizeof(char), bytes, fdWrite) != bytes) {
+            printf("Error: When copying file: Failed to write to file "
+                   "\"%s\".\n",
+                   toPath);
+            goto error;
+        }
+    }
+    if (ferror(fdRead)) {
         printf("Error: When copying file: Failed to read from file "
                "\"%s\".\n",
                fromPath);
+        goto error;
     }
+#else
+    struct stat info;
+    int status = 0;
+    int fdRead = -1;
+    int fdWrite = -1;
 
-    fdWrite = fopen(toPath, "wb");
-    if (fdWrite == NULL) {
+    fdRead = open(fromPath, O_RDONLY);
+    if (fdRead < 0) {
+        printf("Error: When copying file: Could not open input file \"%s\": %s",
+               fromPath, strerror(errno));
+        goto error;
+    }
+
+    if (fstat(fdRead, &info) != 0) {
+        printf("Error: Failed to read information of file "
+               "\"%s\".\n",
+               fromPath);
+        goto error;
+    }
+
+    fdWrite = open(toPath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fdWrite < 0) {
         printf(
             "Error: When copying file: Could not open output file \"%s\": %s",
             toPath, strerror(errno));
         goto error;
     }
-    fwrite(data, sizeof(char), buffSize, fdWrite);
-    if (bytes != buffSize) {
-        printf("Error: When copying file: Failed to write to file "
-               "\"%s\".\n",
-               toPath);
+
+    if (!copyFileData(fdRead, fdWrite, info.st_size)) {
+        printf("Error: When copying file \"%s\" to \"%s\": %s\n", fromPath,
+               toPath, strerror(errno));
+        goto error;
     }
 
-#ifndef WIN32
     status = linuxCopyFilePermissions(fromPath, toPath);
     if (1 != status) {
         goto error;
@@ -2101,6 +2877,7 @@ int copyFile(char *fromPath, char *toPath)
 
     result = 1;
 error:
+#ifdef WIN32
     if (NULL != fdRead) {
         fclose(fdRead);
     }
@@ -2108,6 +2885,17 @@ error:
         fclose(fdWrite);
     }
     free(data);
+#else
+    if (fdRead >= 0) {
+        close(fdRead);
+    }
+    if (fdWrite >= 0 && close(fdWrite) != 0 && result) {
+        printf("Error: When copying file: Failed to write to file "
+               "\"%s\".\n",
+               toPath);
+        result = 0;
+    }
+#endif
 
     return result;
 }
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include <mlle_cr_decrypt.h>
 
@@ -37,6 +38,65 @@
 #define __func__ __FUNCTION__
 #endif
 
+// Most threads that files are encrypted and compressed on, see getThreadCount.
+#define MAX_THREADS 64
+
+// Work for threads: work(arg, index) for each index, see runOnThreads.
+typedef struct {
+    int (*work)(void *arg, size_t index); // returns 0 on failure
+    void *arg;
+    struct mlle_mutex *mutex;
+    size_t next;               // next index, protected by mutex
+    size_t end;                // end of the indices
+    int failed;                // protected by mutex
+} ThreadWork;
+
+// A file to encrypt.
+typedef struct {
+    char *relPath;    // relative to the top-level directory
+    int packageDepth; // depth of the directory of a package.mo, -1 for other files
+} EncryptJob;
+
+// The files to encrypt in a library.
+typedef struct {
+    EncryptJob *jobs;
+    size_t count;
+    size_t capacity;
+} EncryptJobList;
+
+// A file to put in the zip archive.
+typedef struct {
+    char *path;               // the file
+    char *zipPath;            // its name in the archive
+    size_t size;              // length of the file
+    unsigned int mode;        // file mode, for permissions
+    time_t mtime;
+    unsigned long crc32;      // of the file
+    unsigned char *data;      // compressed data, while being written
+    size_t dataSize;
+    int method;               // 0 (stored) or 8 (deflated)
+    unsigned long long offset; // of its local header in the archive
+    char *encryptPath;        // path in the library to encrypt the file for, or NULL
+    int packageDepth;         // depth of the directory of an encrypted package.mo, -1 otherwise
+    int streamed;             // compressed a chunk at a time as it is written, not in memory
+    int zip64;                // sizes in a zip64 extra field, decided when the local header is written
+} ZipEntry;
+
+// The files to put in the zip archive.
+typedef struct {
+    ZipEntry *entries;
+    size_t count;
+    size_t capacity;
+    mlle_cr_context *context; // to encrypt files with while zipping, or NULL
+} ZipEntryList;
+
+// Shared by the threads that encrypt the files of an EncryptJobList.
+typedef struct {
+    mlle_cr_context *context;  // shared by all threads
+    const char *topLevelPath;
+    EncryptJobList *list;
+} EncryptState;
+
 /*************************
  * Free allocated space.
  ************************/
@@ -99,6 +159,39 @@ int validatePath(char *path);
  **********************************************/
 int usingEncryption();
 
+/***********************************************
+ * Check if the library is packaged without
+ * copying it to the staging folder.
+ *
+ * Returns:
+ *      1 - streaming is activated.
+ *      0 - streaming is not activated.
+ **********************************************/
+int usingStreaming();
+
+/***********************************************
+ * Get the format to encrypt files in.
+ *
+ * Returns:
+ *      MLLE_CR_FORMAT_CBC_HMAC - no format given,
+ *                                or "cbc".
+ *      MLLE_CR_FORMAT_GCM - "gcm".
+ *      MLLE_CR_FORMAT_GCM_CHUNKED - "chunked".
+ *      0 - unknown format.
+ **********************************************/
+int getEncryptionFormat();
+
+/***********************************************
+ * Get the number of threads to encrypt and
+ * compress files on.
+ *
+ * Returns:
+ *      the value of -j, or the number of
+ *      processors if it is not given.
+ *      0 - invalid value.
+ **********************************************/
+int getThreadCount();
+
 /***********************************************************
  * Create the .library folder in the top-level directory.
  * The manifest.xml file and the LVE executables will
@@ -245,23 +338,23 @@ int findFileWin32(const char *filename, const char *path);
 int findFileLinux(const char *filename, const char *path);
 
 /****************************************************************
- * Traverse a directory structure on Windows/Linux and encrypt modelica
- * files.
+ * Traverse a directory structure on Windows/Linux and add the
+ * modelica files to encrypt to a list.
  *
  * Parameters:
  *      topLevelPath - base directory for the library.
- *      relPath      - the subdirectory to process.
- *      context_in - context for encryption (NULL for top level when relPath
- *                   is NULL)
+ *      relPath      - the subdirectory to process (NULL for top level).
+ *      depth        - depth of the subdirectory (0 for top level).
+ *      list         - the list to add the files to.
  *
  * Returns:
- *      1 - encryption succeeded.
+ *      1 - all files were added.
  *      0 - failed .
  ****************************************************************/
-int encryptDirectoryWin32(const char *topLevelPath, const char *relPath,
-                          mlle_cr_context *context_in);
-int encryptDirectoryLinux(const char *topLevelPath, const char *relPath,
-                          mlle_cr_context *context_in);
+int findFilesToEncryptWin32(const char *topLevelPath, const char *relPath,
+                            int depth, EncryptJobList *list);
+int findFilesToEncryptLinux(const char *topLevelPath, const char *relPath,
+                            int depth, EncryptJobList *list);
 
 /**********************************************
  * Extract the filename from a path.
@@ -346,95 +439,50 @@ int encryptFile(mlle_cr_context *context, const char *basedir,
 int createZipArchive();
 
 /******************************************************************
- * Creates a zipped archive of a directory on Windows.
+ * Traverse a directory structure on Windows/Linux and add the
+ * files to put in the archive to a list.
  *
  * Parameters:
- *      path - path to the top-level directory.
- *      archiveName - the name of the archive.
+ *      path - path to the directory.
+ *      zipPath - path of the directory in the archive ("" for the
+ *                top level).
  *      encrypted - does the archive contains encrypted files (1)
  *                  or not (0).
+ *      list - the list to add the files to. If it has a context,
+ *             Modelica files are encrypted when they are zipped.
  *
  * Returns:
- *      1 - successfully created the archive.
- *      0 - creating archive failed.
+ *      1 - all files were added.
+ *      0 - failed.
  *****************************************************************/
-int zipDirectoryWin32(char *path, char *archiveName, int encrypted);
-
-/******************************************************************
- * Creates a zipped archive of a directory on Linux.
- *
- * Parameters:
- *      zip         - zip archive handler
- *      path - path to the top-level directory.
- *      archiveName - the name of the archive.
- *      encrypted - does the archive contains encrypted files (1)
- *                  or not (0).
- *
- * Returns:
- *      1 - successfully created the archive.
- *      0 - creating archive failed.
- *****************************************************************/
-int zipDirectoryLinux(struct zip_t *zip, char *path, char *archiveName,
-                      int encrypted);
-
-/**************************************************************
- * Removes the tmp folder name from the incoming path.
- * This needs to be done before adding path to zip container.
- *
- * Parameters:
- *      searchPath - path to remove from.
- *      zipPath    - a path without the tmp folder in it.
- *      zipPathLen - length of zipPath buffer
- *
- * Returns:
- *      1 - successfully created the path.
- *      0 - creating path failed.
- *************************************************************/
-int removeTmpFolderName(char *searchPath, char *zipPath, size_t zipPathLen);
-
-/**************************************************************
- * Open zip archive
- *
- * Parameters:
- *      zip         - zip archive handler
- *      archiveName - path to zip file
- *
- * Returns:
- *      1 - success
- *      0 - failure
- *************************************************************/
-int openZipArchive(struct zip_t **zip, char *archiveName);
-
-/**************************************************************
- * Close zip archive
- *
- * Parameters:
- *      zip - zip archive handler (can be NULL)
- *
- * Returns:
- *      (void)
- *************************************************************/
-void closeZipArchive(struct zip_t *zip);
+int findFilesToZipWin32(char *path, const char *zipPath, int encrypted,
+                        ZipEntryList *list);
+int findFilesToZipLinux(char *path, const char *zipPath, int encrypted,
+                        ZipEntryList *list);
 
 /**************************************************************
- * Add file to zip archive.
+ * Write a zip archive of the files in a list, in the order of
+ * the list. The files are compressed on nThreads threads, a
+ * batch at a time, and written by one. Large files are instead
+ * compressed a chunk at a time while they are written, so that
+ * they are never held in memory. The archive is the same for
+ * any number of threads.
  *
  * Parameters:
- *      zip         - zip archive handler
  *      archiveName - path to zip file
- *      zipPath    - path to file within the zip file
- *      searchPath - path to input file
+ *      list        - the files to add
+ *      nThreads    - number of threads to compress files on
  *
  * Returns:
  *      1 - success
  *      0 - failure
  *************************************************************/
-int addFileToZipArchive(struct zip_t *zip, char *archiveName, char *zipPath,
-                        char *searchPath);
+int writeZipArchive(char *archiveName, ZipEntryList *list, int nThreads);
 
 /*************************************************************************
  * Creates a copy of the folder structure we are making a container of.
- * The folder structure is copied to the users TEMP folder.
+ * The folder structure is copied to the users TEMP folder. When
+ * streaming, only the folder is created, for the .library folder.
  *
  * Returns:
  *      1 if successful, 0 otherwise.
@@ -478,7 +526,9 @@ int deleteTemporaryStagingFolder();
 
 
 /*************************************************************
- * Copy a file from one location to another.
+ * Copy a file from one location to another, and on Linux/macOS also
+ * its permissions. Where the file system allows it the copy is a
+ * reflink or done in the kernel, otherwise a buffer at a time.
  *
  * Parameters:
  *      fromPath - the path to copy from.
@@ -0,0 +1,442 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+/*
+ * Unit tests of the decryptor API that the LVE does not use, run directly
+ * on the decryptor library:
+ *
+ *  chunks - decrypt a file in the chunked format a chunk at a time, out of
+ *           order, with mlle_cr_chunk_info and mlle_cr_decrypt_chunk, and
+ *           check that swapped, truncated, appended and out-of-range chunks
+ *           are rejected.
+ *  batch  - decrypt files of several directories and formats, package.moc
+ *           files among them, with mlle_cr_decrypt_batch, and check that
+ *           only the file tampered with fails and that the others give the
+ *           same result as mlle_cr_decrypt.
+ *  parallel - decrypt a file in the chunked format of several chunks, to
+ *           another buffer and in place, and check that a tampered chunk
+ *           in the middle is rejected. Run with SEMLA_DECRYPT_PARALLEL_MIN=1
+ *           and SEMLA_DECRYPT_THREADS set to more than 1, so that the file
+ *           is decrypted on several threads.
+ *
+ * Usage: test_decryptor <test> <work dir>
+ *
+ * The encrypted files are written to the work directory, which is created
+ * if needed. No LVE or license manager is needed.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+/* libcrypto-compat.h must be first */
+#include "libcrypto-compat.h"
+
+#include "mlle_cr_crypt.h"
+#include "mlle_cr_decrypt.h"
+#include "mlle_cr_encrypt.h"
+
+#define PATH_LEN (1024)
+
+/* Chunks in the file of the chunks test, all full so that a chunk can be appended. */
+#define TEST_CHUNKS (4)
+
+/* Files of the batch test, and the one of them that is tampered with. */
+#define BATCH_FILES (9)
+#define BATCH_TAMPERED (3)
+
+/* Full chunks in the file of the parallel test, which is followed by a shorter one. */
+#define PARALLEL_CHUNKS (8)
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            goto cleanup; \
+        } \
+    } while (0)
+
+struct enc_file {
+    char *data;
+    size_t len;
+};
+
+static int make_dir(const char *path)
+{
+#ifdef _WIN32
+    if (_mkdir(path) != 0 && errno != EEXIST) {
+#else
+    if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+#endif
+        fprintf(stderr, "Could not create directory %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+/* Fill buf with bytes that differ between files and positions. */
+static void fill_plain(char *buf, size_t len, unsigned int seed)
+{
+    size_t i = 0;
+
+    for (i = 0; i < len; i++) {
+        seed = seed * 1103515245u + 12345u;
+        buf[i] = (char) (seed >> 16);
+    }
+}
+
+/*
+ * Encrypt the len bytes at plain for rel, a path ending in .mo, in the format set for context, and
+ * write the result to the .moc file in base. The encrypted data is kept in file if it is not NULL.
+ * Returns 1 on success and 0 on failure.
+ */
+static int write_encrypted(mlle_cr_context *context, const char *base, const char *rel,
+                           const char *plain, size_t len, struct enc_file *file)
+{
+    char path[PATH_LEN];
+    size_t cap = mlle_cr_encrypt_mem_size(context, rel, len);
+    char *buf = malloc(cap);
+    size_t enc_len = 0;
+    FILE *out = NULL;
+    int ok = 0;
+
+    if (buf == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+    enc_len = mlle_cr_encrypt_mem(context, rel, plain, len, buf, cap);
+    if (enc_len == 0) {
+        fprintf(stderr, "Could not encrypt %s\n", rel);
+        free(buf);
+        return 0;
+    }
+    snprintf(path, sizeof(path), "%s/%sc", base, rel);
+    out = fopen(path, "wb");
+    ok = out != NULL && fwrite(buf, 1, enc_len, out) == enc_len;
+    if (out != NULL && fclose(out) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Could not write %s: %s\n", path, strerror(errno));
+        free(buf);
+        return 0;
+    }
+    if (file != NULL) {
+        file->data = buf;
+        file->len = enc_len;
+    } else {
+        free(buf);
+    }
+    return 1;
+}
+
+/*
+ * Write an encrypted package.moc to base and base/d1, so that the key of files in d1 is masked.
+ * Returns 1 on success and 0 on failure.
+ */
+static int write_packages(mlle_cr_context *context, const char *base)
+{
+    static const char package[] = "package P\nend P;\n";
+    char path[PATH_LEN];
+
+    snprintf(path, sizeof(path), "%s/d1", base);
+    return make_dir(base) && make_dir(path)
+        && write_encrypted(context, base, "package.mo", package, sizeof(package) - 1, NULL)
+        && write_encrypted(context, base, "d1/package.mo", package, sizeof(package) - 1, NULL);
+}
+
+static int test_chunks(const char *base)
+{
+    const char *rel = "d1/chunks.moc";
+    const size_t plain_len = TEST_CHUNKS * MLLE_CR_CHUNK_LENGTH;
+    const size_t stride = MLLE_CR_CHUNK_LENGTH + MLLE_CR_GCM_TAG_LENGTH;
+    static const size_t order[TEST_CHUNKS] = { 2, 0, 3, 1 };
+    mlle_cr_context *encryptor = mlle_cr_create(base);
+    mlle_cr_context *context = NULL;
+    struct enc_file file = { 0 };
+    char *plain = malloc(plain_len);
+    char *out = malloc(plain_len + stride);
+    char *appended = NULL;
+    const char *chunk = NULL;
+    size_t enc_chunk_len = 0;
+    size_t chunk_count = 0;
+    size_t i = 0;
+    int res = 0;
+
+    CHECK(encryptor != NULL && plain != NULL && out != NULL);
+    CHECK(mlle_cr_set_format(encryptor, MLLE_CR_FORMAT_GCM_CHUNKED));
+    CHECK(write_packages(encryptor, base));
+    fill_plain(plain, plain_len, 1);
+    CHECK(write_encrypted(encryptor, base, "d1/chunks.mo", plain, plain_len, &file));
+
+    /* A fresh context, so that the key mask of d1 is looked up by mlle_cr_decrypt_chunk. */
+    context = mlle_cr_create(base);
+    CHECK(context != NULL);
+    CHECK(mlle_cr_chunk_info(file.data, file.len, file.len, &enc_chunk_len, &chunk_count) == 1);
+    CHECK(enc_chunk_len == stride && chunk_count == TEST_CHUNKS);
+    CHECK(file.len == MLLE_CR_CHUNK_HEADER_LEN + TEST_CHUNKS * stride);
+
+    /* Out of order, each chunk to its place in out. */
+    for (i = 0; i < TEST_CHUNKS; i++) {
+        chunk = file.data + MLLE_CR_CHUNK_HEADER_LEN + order[i] * stride;
+        CHECK(mlle_cr_decrypt_chunk(context, rel, file.data, file.len, order[i], chunk, stride,
+                                    out + order[i] * MLLE_CR_CHUNK_LENGTH) == MLLE_CR_CHUNK_LENGTH);
+    }
+    CHECK(memcmp(out, plain, plain_len) == 0);
+
+    /* A chunk at the index of another one. */
+    chunk = file.data + MLLE_CR_CHUNK_HEADER_LEN + stride;
+    CHECK(mlle_cr_decrypt_chunk(context, rel, file.data, file.len, 0, chunk, stride, out) == -1);
+    chunk = file.data + MLLE_CR_CHUNK_HEADER_LEN;
+    CHECK(mlle_cr_decrypt_chunk(context, rel, file.data, file.len, 1, chunk, stride, out) == -1);
+
+    /* The last chunk cut short, and the last chunk dropped so that the one before it is the last. */
+    chunk = file.data + MLLE_CR_CHUNK_HEADER_LEN + (TEST_CHUNKS - 1) * stride;
+    CHECK(mlle_cr_decrypt_chunk(context, rel, file.data, file.len - 1, TEST_CHUNKS - 1, chunk, stride - 1,
+                                out) == -1);
+    chunk = file.data + MLLE_CR_CHUNK_HEADER_LEN + (TEST_CHUNKS - 2) * stride;
+    CHECK(mlle_cr_decrypt_chunk(context, rel, file.data, file.len - stride, TEST_CHUNKS - 2, chunk, stride,
+                                out) == -1);
+    CHECK(mlle_cr_decrypt(context, rel, file.data, file.len - 1, out) == -1);
+
+    /* A copy of the first chunk appended, so that the real last chunk is no longer the last. */
+    appended = malloc(file.len + stride);
+    CHECK(appended != NULL);
+    memcpy(appended, file.data, file.len);
+    memcpy(appended + file.len, file.data + MLLE_CR_CHUNK_HEADER_LEN, stride);
+    CHECK(mlle_cr_chunk_info(appended, file.len + stride, file.len + stride, &enc_chunk_len, &chunk_count) == 1);
+    CHECK(chunk_count == TEST_CHUNKS + 1);
+    chunk = appended + MLLE_CR_CHUNK_HEADER_LEN + (TEST_CHUNKS - 1) * stride;
+    CHECK(mlle_cr_decrypt_chunk(context, rel, appended, file.len + stride, TEST_CHUNKS - 1, chunk, stride,
+                                out) == -1);
+    chunk = appended + MLLE_CR_CHUNK_HEADER_LEN + TEST_CHUNKS * stride;
+    CHECK(mlle_cr_decrypt_chunk(context, rel, appended, file.len + stride, TEST_CHUNKS, chunk, stride,
+                                out) == -1);
+    CHECK(mlle_cr_decrypt(context, rel, appended, file.len + stride, out) == -1);
+
+    /* Indexes past the last chunk. */
+    chunk = file.data + MLLE_CR_CHUNK_HEADER_LEN;
+    CHECK(mlle_cr_decrypt_chunk(context, rel, file.data, file.len, TEST_CHUNKS, chunk, stride, out) == -1);
+    CHECK(mlle_cr_decrypt_chunk(context, rel, file.data, file.len, (size_t) -1, chunk, stride, out) == -1);
+
+    /* The untouched file still decrypts, a chunk at a time and as a whole. */
+    CHECK(mlle_cr_decrypt_chunk(context, rel, file.data, file.len, 0, file.data + MLLE_CR_CHUNK_HEADER_LEN,
+                                stride, out) == MLLE_CR_CHUNK_LENGTH);
+    CHECK(mlle_cr_decrypt(context, rel, file.data, file.len, out) == (int) plain_len);
+    CHECK(memcmp(out, plain, plain_len) == 0);
+
+    /* Data in the other formats cannot be decrypted by chunks. */
+    CHECK(mlle_cr_set_format(encryptor, MLLE_CR_FORMAT_GCM));
+    free(file.data);
+    file.data = NULL;
+    CHECK(write_encrypted(encryptor, base, "d1/whole.mo", plain, MLLE_CR_CHUNK_LENGTH, &file));
+    CHECK(mlle_cr_chunk_info(file.data, file.len, file.len, &enc_chunk_len, &chunk_count) == 0);
+    res = 1;
+
+cleanup:
+    mlle_cr_free(encryptor);
+    mlle_cr_free(context);
+    free(file.data);
+    free(appended);
+    free(plain);
+    free(out);
+    return res;
+}
+
+static int test_batch(const char *base)
+{
+    /* In the order of encryption, each package.mo before the other files in and below its directory. */
+    static const struct {
+        const char *rel;
+        int format;
+        size_t len;
+    } files[BATCH_FILES] = {
+        { "package.mo", MLLE_CR_FORMAT_CBC_HMAC, 50 },
+        { "d1/package.mo", MLLE_CR_FORMAT_GCM, 60 },
+        { "d1/a.mo", MLLE_CR_FORMAT_CBC_HMAC, 100 },
+        { "d1/b.mo", MLLE_CR_FORMAT_CBC_HMAC, 5000 },
+        { "d1/c.mo", MLLE_CR_FORMAT_CBC_HMAC, 16 },
+        { "d2/package.mo", MLLE_CR_FORMAT_GCM, 300 },
+        { "d2/e.mo", MLLE_CR_FORMAT_GCM, 20000 },
+        { "d1/d3/package.mo", MLLE_CR_FORMAT_GCM_CHUNKED, 70000 },
+        { "d1/d3/f.mo", MLLE_CR_FORMAT_GCM_CHUNKED, 200000 },
+    };
+    /* The order of the batch, with the tampered file between two with the same key and format. */
+    static const size_t order[BATCH_FILES] = { 2, BATCH_TAMPERED, 4, 6, 5, 1, 8, 7, 0 };
+    mlle_cr_context *encryptor = mlle_cr_create(base);
+    mlle_cr_context *reference = NULL;
+    mlle_cr_context *context = NULL;
+    struct enc_file enc[BATCH_FILES] = { { 0 } };
+    char rels[BATCH_FILES][PATH_LEN];
+    const char *relpaths[BATCH_FILES];
+    char *ins[BATCH_FILES] = { 0 };
+    size_t in_lens[BATCH_FILES];
+    char *outs[BATCH_FILES] = { 0 };
+    char *expected = NULL;
+    char *plain = NULL;
+    char path[PATH_LEN];
+    int results[BATCH_FILES];
+    int expected_len = 0;
+    size_t i = 0;
+    size_t f = 0;
+    int res = 0;
+
+    CHECK(encryptor != NULL && make_dir(base));
+    snprintf(path, sizeof(path), "%s/d1", base);
+    CHECK(make_dir(path));
+    snprintf(path, sizeof(path), "%s/d2", base);
+    CHECK(make_dir(path));
+    snprintf(path, sizeof(path), "%s/d1/d3", base);
+    CHECK(make_dir(path));
+    for (f = 0; f < BATCH_FILES; f++) {
+        plain = malloc(files[f].len);
+        CHECK(plain != NULL);
+        fill_plain(plain, files[f].len, 10 + (unsigned int) f);
+        CHECK(mlle_cr_set_format(encryptor, files[f].format));
+        CHECK(write_encrypted(encryptor, base, files[f].rel, plain, files[f].len, &enc[f]));
+        free(plain);
+        plain = NULL;
+    }
+
+    for (i = 0; i < BATCH_FILES; i++) {
+        f = order[i];
+        snprintf(rels[i], sizeof(rels[i]), "%sc", files[f].rel);
+        relpaths[i] = rels[i];
+        ins[i] = malloc(enc[f].len);
+        outs[i] = malloc(enc[f].len);
+        CHECK(ins[i] != NULL && outs[i] != NULL);
+        memcpy(ins[i], enc[f].data, enc[f].len);
+        in_lens[i] = enc[f].len;
+    }
+    ins[1][in_lens[1] / 2] ^= 1;
+
+    /* Fresh contexts, so that the batch looks up the key masks itself. */
+    context = mlle_cr_create(base);
+    reference = mlle_cr_create(base);
+    CHECK(context != NULL && reference != NULL);
+    CHECK(mlle_cr_decrypt_batch(context, BATCH_FILES, relpaths, ins, in_lens, outs, results) == 1);
+    CHECK(results[1] == -1);
+    for (i = 0; i < BATCH_FILES; i++) {
+        if (i == 1) {
+            continue;
+        }
+        expected = malloc(in_lens[i]);
+        CHECK(expected != NULL);
+        expected_len = mlle_cr_decrypt(reference, relpaths[i], ins[i], in_lens[i], expected);
+        CHECK(expected_len >= 0);
+        CHECK(results[i] == expected_len);
+        CHECK(memcmp(outs[i], expected, expected_len) == 0);
+        free(expected);
+        expected = NULL;
+    }
+    /* A file that is not a package.moc decrypts to its plaintext, which has no key mask at the end. */
+    CHECK(results[0] == (int) files[order[0]].len);
+
+    CHECK(mlle_cr_decrypt_batch(context, 0, NULL, NULL, NULL, NULL, NULL) == 0);
+    CHECK(mlle_cr_decrypt_batch(NULL, 1, relpaths, ins, in_lens, outs, results) == -1);
+    res = 1;
+
+cleanup:
+    mlle_cr_free(encryptor);
+    mlle_cr_free(reference);
+    mlle_cr_free(context);
+    for (i = 0; i < BATCH_FILES; i++) {
+        free(enc[i].data);
+        free(ins[i]);
+        free(outs[i]);
+    }
+    free(expected);
+    free(plain);
+    return res;
+}
+
+static int test_parallel(const char *base)
+{
+    const char *rel = "d1/parallel.moc";
+    const size_t plain_len = PARALLEL_CHUNKS * MLLE_CR_CHUNK_LENGTH + 1000;
+    const size_t stride = MLLE_CR_CHUNK_LENGTH + MLLE_CR_GCM_TAG_LENGTH;
+    mlle_cr_context *encryptor = mlle_cr_create(base);
+    mlle_cr_context *context = NULL;
+    struct enc_file file = { 0 };
+    char *plain = malloc(plain_len);
+    char *out = malloc(plain_len);
+    char *copy = NULL;
+    char *in_place = NULL;
+    int res = 0;
+
+    CHECK(encryptor != NULL && plain != NULL && out != NULL);
+    CHECK(mlle_cr_set_format(encryptor, MLLE_CR_FORMAT_GCM_CHUNKED));
+    CHECK(write_packages(encryptor, base));
+    fill_plain(plain, plain_len, 2);
+    CHECK(write_encrypted(encryptor, base, "d1/parallel.mo", plain, plain_len, &file));
+    copy = malloc(file.len);
+    CHECK(copy != NULL);
+
+    context = mlle_cr_create(base);
+    CHECK(context != NULL);
+    CHECK(mlle_cr_decrypt(context, rel, file.data, file.len, out) == (int) plain_len);
+    CHECK(memcmp(out, plain, plain_len) == 0);
+    memcpy(copy, file.data, file.len);
+    CHECK(mlle_cr_decrypt_inplace(context, rel, copy, file.len, &in_place) == (int) plain_len);
+    CHECK(memcmp(in_place, plain, plain_len) == 0);
+
+    /* One byte changed in a chunk in the middle, which another thread than the first decrypts. */
+    memcpy(copy, file.data, file.len);
+    copy[MLLE_CR_CHUNK_HEADER_LEN + (PARALLEL_CHUNKS / 2) * stride + 100] ^= 1;
+    CHECK(mlle_cr_decrypt(context, rel, copy, file.len, out) == -1);
+    CHECK(mlle_cr_decrypt_inplace(context, rel, copy, file.len, &in_place) == -1);
+
+    /* The context still works after the failures. */
+    CHECK(mlle_cr_decrypt(context, rel, file.data, file.len, out) == (int) plain_len);
+    CHECK(memcmp(out, plain, plain_len) == 0);
+    res = 1;
+
+cleanup:
+    mlle_cr_free(encryptor);
+    mlle_cr_free(context);
+    free(file.data);
+    free(copy);
+    free(plain);
+    free(out);
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    int ok = 0;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <test> <work dir>\n"
+                "Tests: chunks, batch, parallel\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (strcmp(argv[1], "chunks") == 0) {
+        ok = test_chunks(argv[2]);
+    } else if (strcmp(argv[1], "batch") == 0) {
+        ok = test_batch(argv[2]);
+    } else if (strcmp(argv[1], "parallel") == 0) {
+        ok = test_parallel(argv[2]);
+    } else {
+        fprintf(stderr, "Unknown test %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %s\n", argv[1], ok ? "passed" : "FAILED");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
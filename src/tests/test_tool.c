@@ -164,6 +164,11 @@ const char * facit_path, const char **facit_files
         int i = -1;
         char test_name[1024];
 
+        check(mlle_connections_startup_ns(lve, MLLE_STARTUP_TOTAL) >=
+                  mlle_connections_startup_ns(lve, MLLE_STARTUP_HANDSHAKE) &&
+              mlle_connections_startup_ns(lve, MLLE_STARTUP_HANDSHAKE) > 0,
+              "Test startup profile", "startup times not recorded");
+
         check_mlle(mlle_tool_version(lve, 1, 1, &error), "Test protocol version [1, 1]", &error);
         mlle_error_free(&error);
 
@@ -176,6 +181,18 @@ const char * facit_path, const char **facit_files
             snprintf(test_name, sizeof(test_name), "Test valid feature ('%s')", feature);
             check_mlle(mlle_tool_feature(lve, feature, &error), test_name, &error);
             mlle_error_free(&error);
+
+            snprintf(test_name, sizeof(test_name), "Test valid feature again ('%s')", feature);
+            check_mlle(mlle_tool_feature(lve, feature, &error), test_name, &error);
+            mlle_error_free(&error);
+
+            snprintf(test_name, sizeof(test_name), "Test return feature ('%s')", feature);
+            check_mlle(mlle_tool_returnfeature(lve, feature, &error), test_name, &error);
+            mlle_error_free(&error);
+
+            snprintf(test_name, sizeof(test_name), "Test valid feature after return ('%s')", feature);
+            check_mlle(mlle_tool_feature(lve, feature, &error), test_name, &error);
+            mlle_error_free(&error);
         }
 
         if (0 != strcmp(no_feature, "DONT_TEST"))
@@ -183,14 +200,44 @@ const char * facit_path, const char **facit_files
 			snprintf(test_name, sizeof(test_name), "Test invalid feature ('%s')", no_feature);
 			check_mlle(!mlle_tool_feature(lve, no_feature, &error), test_name, &error);
 			snprintf(test_name, sizeof(test_name), "Test invalid feature error message ('%s')", no_feature);
+            check(0 != strlen(mlle_error_get_message(error)), test_name, "invalid feature error message is empty string");
+			mlle_error_free(&error);
+			snprintf(test_name, sizeof(test_name), "Test invalid feature again ('%s')", no_feature);
+			check_mlle(!mlle_tool_feature(lve, no_feature, &error), test_name, &error);
+			snprintf(test_name, sizeof(test_name), "Test invalid feature error message again ('%s')", no_feature);
             check(0 != strlen(mlle_error_get_message(error)), test_name, "invalid feature error message is empty string");
 			mlle_error_free(&error);
 		}
 
+        if (0 != strcmp(feature, "DONT_TEST") && 0 != strcmp(no_feature, "DONT_TEST"))
+        {
+            const char *features[2];
+            int granted[2] = { 0, 1 };
+
+            features[0] = feature;
+            features[1] = no_feature;
+            check_mlle(mlle_tool_features(lve, 2, features, granted, &error), "Test FEATURES", &error);
+            mlle_error_free(&error);
+            check(granted[0] && !granted[1], "Test FEATURES result", "unexpected granted/denied vector");
+        }
+
         for (i = 0; i < number_of_files; i++) {
             get_file_and_compare(library_files[i], facit_files[i], facit_path, lve);
         }
 
+        if (number_of_files > 0)
+        {
+            char *stats = mlle_tool_stats(lve, &error);
+
+            check_mlle(stats != NULL, "Test STATS", &error);
+            mlle_error_free(&error);
+            check(stats != NULL && strstr(stats, "files_served=") != NULL,
+                  "Test STATS contents", "files_served missing from STATS reply");
+            check(stats != NULL && strstr(stats, "startup_accept_ns=") != NULL,
+                  "Test STATS startup contents", "startup_accept_ns missing from STATS reply");
+            free(stats);
+        }
+
         mlle_connections_free(&lve);
         }
 }
@@ -35,6 +35,7 @@
 #include "mlle_io.h"
 #include "mlle_parse_command.h"
 #include "mlle_utils.h"
+#include "mlle_stats.h"
 #include "mlle_licensing.h"
 
 #ifdef INCLUDE_OPENSSL_APPLINK
@@ -62,32 +63,88 @@ mlle_connections_free(struct mlle_connections **connections)
     }
 }
 
+static const char *startup_phase_names[MLLE_STARTUP_PHASE_SIZE] = {
+    "access", "spawn", "ssl_setup", "handshake", "total"
+};
+
+unsigned long long
+mlle_connections_startup_ns(const struct mlle_connections *connections,
+                            enum mlle_startup_phase phase)
+{
+    if (connections == NULL || phase >= MLLE_STARTUP_PHASE_SIZE) {
+        return 0;
+    }
+    return connections->startup_ns[phase];
+}
+
+void
+mlle_connections_startup_report(const struct mlle_connections *connections,
+                                FILE *out)
+{
+    int i = 0;
+
+    if (connections == NULL || out == NULL) {
+        return;
+    }
+    fprintf(out, "SEMLA startup:");
+    for (i = 0; i < MLLE_STARTUP_PHASE_SIZE; i++) {
+        fprintf(out, " %s=%lluus", startup_phase_names[i],
+                connections->startup_ns[i] / 1000);
+    }
+    fprintf(out, "\n");
+    fflush(out);
+}
+
+// Append the startup report to the file named by SEMLA_STARTUP_PROFILE.
+static void
+mlle_startup_profile(const struct mlle_connections *connections)
+{
+    const char *path = getenv("SEMLA_STARTUP_PROFILE");
+    FILE *out = NULL;
+
+    if (path == NULL || path[0] == '\0') {
+        return;
+    }
+    out = fopen(path, "a");
+    if (out != NULL) {
+        mlle_connections_startup_report(connections, out);
+        fclose(out);
+    }
+}
+
 struct mlle_connections *
 mlle_start_executable(const char *exec_name,
                       struct mlle_error **error)
 {
     struct mlle_connections *lve = NULL;
     struct mlle_connections *result = NULL;
+    mlle_stats_ns start = mlle_stats_now();
+    mlle_stats_ns phase_start = 0;
 
-    // Startup LVE.
+    // Startup LVE. Sets the access and spawn times.
     lve = mlle_spawn(exec_name, error);
     if (lve == NULL) {
         goto cleanup;
     }
 
     // Setup SSL
-    // Setup SSL
+    phase_start = mlle_stats_now();
     if (!ssl_setup_tool(&lve, error))
     {
         goto cleanup;
     }
+    lve->startup_ns[MLLE_STARTUP_SSL_SETUP] = mlle_stats_now() - phase_start;
 
     // Perform handshake with LVE
+    phase_start = mlle_stats_now();
     if (!tool_perform_handshake(&lve, error))
     {
         goto cleanup;
     }
+    lve->startup_ns[MLLE_STARTUP_HANDSHAKE] = mlle_stats_now() - phase_start;
+    lve->startup_ns[MLLE_STARTUP_TOTAL] = mlle_stats_now() - start;
 
+    mlle_startup_profile(lve);
     result = lve;
 
 cleanup:
@@ -316,6 +373,69 @@ int mlle_tool_feature(const struct mlle_connections *connections,
     return 1;
 }
 
+int mlle_tool_features(const struct mlle_connections *connections,
+                   size_t nfeatures,
+                   const char **features,
+                   int *granted,
+                   struct mlle_error **error)
+{
+    struct mlle_command command = { 0 };
+    size_t length = 0;
+    size_t i = 0;
+    char *data = NULL;
+    char *pos = NULL;
+
+    assert(features != NULL && granted != NULL && nfeatures > 0);
+
+    for (i = 0; i < nfeatures; i++) {
+        assert(features[i] != NULL);
+        if (strchr(features[i], '\n') != NULL) {
+            mlle_error_set(error, MLLE_ERROR_DOMAIN_TOOL, MLLE_TOOL_ERROR_PROTOCOL,
+                    "Feature name '%s' contains a line feed.", features[i]);
+            return 0;
+        }
+        length += strlen(features[i]) + 1;
+    }
+
+    data = malloc(length);
+    if (data == NULL) {
+        mlle_error_set_literal(error, 1, 1, "Out of memory.");
+        return 0;
+    }
+    pos = data;
+    for (i = 0; i < nfeatures; i++) {
+        size_t feature_length = strlen(features[i]);
+        memcpy(pos, features[i], feature_length);
+        pos += feature_length;
+        *pos++ = '\n';
+    }
+
+    /* Skip the last LF. */
+    mlle_send_length_form(connections->ssl, MLLE_PROTOCOL_FEATURES_CMD,
+            length - 1, data);
+    free(data);
+
+    if (!mlle_expect_command(connections->ssl, MLLE_PROTOCOL_FEATURES_CMD,
+            &command, error))
+    {
+        return 0;
+    }
+
+    if (command.length != nfeatures) {
+        mlle_error_set(error, MLLE_ERROR_DOMAIN_TOOL, MLLE_TOOL_ERROR_PROTOCOL,
+                "Expected " MLLE_SIZE_T_FMT " answers to FEATURES, got " MLLE_SIZE_T_FMT ".",
+                nfeatures, command.length);
+        free(command.data);
+        return 0;
+    }
+    for (i = 0; i < nfeatures; i++) {
+        granted[i] = command.data[i] == 'Y';
+    }
+    free(command.data);
+
+    return 1;
+}
+
 int
 mlle_tool_returnfeature(const struct mlle_connections *connections,
                         const char *feature,
@@ -392,6 +512,23 @@ mlle_tool_returnlicense(const struct mlle_connections *connections,
     return 1;
 }
 
+char *
+mlle_tool_stats(const struct mlle_connections *connections,
+                struct mlle_error **error)
+{
+    struct mlle_command command = { 0 };
+
+    mlle_send_simple_form(connections->ssl, MLLE_PROTOCOL_STATS_CMD);
+    if (!mlle_expect_command(connections->ssl, MLLE_PROTOCOL_STATSCONT_CMD,
+            &command, error))
+    {
+        return NULL;
+    }
+
+    /* mlle_read_command NUL terminates the data. */
+    return command.data;
+}
+
 struct mlle_file_contents *
 mlle_tool_file(const struct mlle_connections *connections,
                const char *file_path,
@@ -48,6 +48,38 @@ enum mlle_tool_error {
     MLLE_TOOL_ERROR_SIZE,
 };
 
+/*
+ * Steps of mlle_start_executable(). The handshake includes the time
+ * the LVE needs to start up and set up its side of the connection;
+ * the LVE's own steps are reported by mlle_tool_stats() as
+ * startup_<step>_ns.
+ */
+enum mlle_startup_phase {
+    MLLE_STARTUP_ACCESS,        // Checking that the LVE exists and is executable.
+    MLLE_STARTUP_SPAWN,         // Creating pipes and starting the LVE process.
+    MLLE_STARTUP_SSL_SETUP,     // Setting up keys, certificate and SSL structure.
+    MLLE_STARTUP_HANDSHAKE,     // TLS handshake with the LVE.
+    MLLE_STARTUP_TOTAL,         // All of mlle_start_executable().
+
+    /* This value MUST be the last in the enum. */
+    MLLE_STARTUP_PHASE_SIZE
+};
+
+/**********************************************************
+ * Start the LVE and set up a TLS connection to it.
+ *
+ * If the environment variable SEMLA_STARTUP_PROFILE names
+ * a file, a line with the time of each startup step is
+ * appended to it, see mlle_connections_startup_report().
+ *
+ * Parameters:
+ *      exec_name - path of the LVE executable.
+ *      error - structure for reporting errors.
+ *
+ * Returns:
+ *      The connection, to be freed with
+ *      mlle_connections_free(). NULL on failure.
+ *********************************************************/
 struct mlle_connections *
 mlle_start_executable(const char *exec_name,
                       struct mlle_error **error);
@@ -55,6 +87,34 @@ mlle_start_executable(const char *exec_name,
 void
 mlle_connections_free(struct mlle_connections **connections);
 
+/**********************************************************
+ * Get the time spent in one step of starting the LVE.
+ *
+ * Parameters:
+ *      connections - connection from mlle_start_executable().
+ *      phase - the step.
+ *
+ * Returns:
+ *      The time in nanoseconds.
+ *********************************************************/
+unsigned long long
+mlle_connections_startup_ns(const struct mlle_connections *connections,
+                            enum mlle_startup_phase phase);
+
+/**********************************************************
+ * Write the time of each step of starting the LVE as one
+ * line, e.g.
+ * "SEMLA startup: access=12us spawn=350us ssl_setup=2100us
+ * handshake=41000us total=43462us".
+ *
+ * Parameters:
+ *      connections - connection from mlle_start_executable().
+ *      out - stream to write to.
+ *********************************************************/
+void
+mlle_connections_startup_report(const struct mlle_connections *connections,
+                                FILE *out);
+
 
 /**********************************************************
  * Send command VERSION from Tool to LVE and expecting the
@@ -115,6 +175,29 @@ int mlle_tool_feature(const struct mlle_connections *connections,
 
 
 
+/**********************************************************
+ * Send command FEATURES from Tool to LVE, checking out
+ * several features in one round trip.
+ *
+ * Parameters:
+ *      connections - communication information.
+ *      nfeatures - number of features.
+ *      features - the features to check out. Names may not
+ *                 contain line feeds.
+ *      granted - set to 1 for each feature that was checked
+ *                out, 0 for each that was denied.
+ *      error - structure for reporting errors.
+ *
+ * Returns:
+ *      1 - Operation was successful, granted is set.
+ *      0 - Operation failed.
+ *********************************************************/
+int mlle_tool_features(const struct mlle_connections *connections,
+                   size_t nfeatures,
+                   const char **features,
+                   int *granted,
+                   struct mlle_error **error);
+
 int
 mlle_tool_returnfeature(const struct mlle_connections *connections,
                         const char *feature,
@@ -130,6 +213,24 @@ mlle_tool_returnlicense(const struct mlle_connections *connections,
                         const char *package,
                         struct mlle_error **error);
 
+/**********************************************************
+ * Send command STATS from Tool to LVE, and get the LVE's
+ * performance counters back.
+ *
+ * Parameters:
+ *      connections - communication information.
+ *      error - structure for reporting errors.
+ *
+ * Returns:
+ *      A NUL terminated string of "<key>=<value>" lines, e.g.
+ *      "files_served=12", "decrypt_total_ns=53211" or
+ *      "license_p99_ns=120000", to be freed by the caller.
+ *      NULL if the operation failed.
+ *********************************************************/
+char *
+mlle_tool_stats(const struct mlle_connections *connections,
+                struct mlle_error **error);
+
 struct mlle_file_contents *
 mlle_tool_file(const struct mlle_connections *connections,
                const char *file_path,
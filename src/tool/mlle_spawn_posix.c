@@ -25,6 +25,7 @@
 #include "mlle_types.h"
 #include "mlle_error.h"
 #include "mlle_spawn.h"
+#include "mlle_stats.h"
 
 
 /********************************************************************
@@ -45,6 +46,8 @@ mlle_spawn(const char *exec_name,
     int child_to_parent_pipe_fd[2] = { -1, -1 };
     int status = 0;
     struct mlle_connections *connections = NULL;
+    mlle_stats_ns start = mlle_stats_now();
+    mlle_stats_ns spawn_start = 0;
 
     status = access(exec_name, F_OK);
     if (status == -1) {
@@ -56,6 +59,7 @@ mlle_spawn(const char *exec_name,
         mlle_error_set(error, 1, 1, "execute permission is not set on LVE \"%s\": Error: %s", exec_name, strerror(errno));
         return NULL;
     }
+    spawn_start = mlle_stats_now();
 
     fflush(NULL);
     status = pipe(parent_to_child_pipe_fd);
@@ -103,6 +107,8 @@ mlle_spawn(const char *exec_name,
         if (connections != NULL) {
             connections->fd_to_child = parent_to_child_pipe_fd[PIPE_WRITE_INDEX];
             connections->fd_from_child = child_to_parent_pipe_fd[PIPE_READ_INDEX];
+            connections->startup_ns[MLLE_STARTUP_ACCESS] = spawn_start - start;
+            connections->startup_ns[MLLE_STARTUP_SPAWN] = mlle_stats_now() - spawn_start;
         } else {
             mlle_error_set_literal(error, 1, 1, "Out of memory.");
         }
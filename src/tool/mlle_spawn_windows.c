@@ -24,6 +24,7 @@
 #include "mlle_types.h"
 #include "mlle_error.h"
 #include "mlle_spawn.h"
+#include "mlle_stats.h"
 
 #define   READ_FD 0
 #define   WRITE_FD 1
@@ -57,6 +58,7 @@ mlle_spawn(const char *exec_name,
     int tmp_fd_for_stdout_stream = -1;
     intptr_t child_handle = 0;
     struct mlle_connections *connections = NULL;
+    mlle_stats_ns start = mlle_stats_now();
 
     // New. Don't change anything.
     setvbuf( stdin, NULL, _IONBF, 0 );
@@ -186,6 +188,8 @@ mlle_spawn(const char *exec_name,
     if (connections != NULL) {
         connections->fd_to_child = parent_to_child_pipe_fd[PIPE_WRITE_INDEX];
         connections->fd_from_child = child_to_parent_pipe_fd[PIPE_READ_INDEX];
+        // No access() checks here, _spawnl reports a missing executable.
+        connections->startup_ns[MLLE_STARTUP_SPAWN] = mlle_stats_now() - start;
     } else {
         mlle_error_set_literal(error, 1, 1, "Out of memory.");
     }
@@ -19,11 +19,14 @@
 
 
 #include <openssl/ssl.h>
+#include "mlle_licensing.h"
 
 struct mlle_connections {
     int fd_to_child;    // Pipes. Used instead of streams
     int fd_from_child;  // that didn't work well with OpenSSL.
     SSL *ssl;
+    // Time spent in each step of mlle_start_executable().
+    unsigned long long startup_ns[MLLE_STARTUP_PHASE_SIZE];
 };
 
 enum pipe_end {
@@ -0,0 +1,119 @@
+/*
+    Copyright (C) 2022 Modelica Association
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the BSD style license.
+
+     This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    BSD_License.txt file for more details.
+*/
+
+/*
+ * Decode the binary event traces that the LVE appends to its log file
+ * (SEMLA_LVE_LOG_FILE) into text, one event per line, in time order:
+ *
+ *     <microseconds since first event> T<thread> <event> <arg0> <arg1> <arg2>
+ *
+ * The trace must be decoded on the same kind of machine that wrote it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* mlle_portability.h must be first */
+#include "mlle_portability.h"
+#include "mlle_trace.h"
+
+static int compare_events(const void *a, const void *b)
+{
+    const struct mlle_trace_event *ea = a;
+    const struct mlle_trace_event *eb = b;
+
+    if (ea->timestamp != eb->timestamp) {
+        return ea->timestamp < eb->timestamp ? -1 : 1;
+    }
+    return ea->thread < eb->thread ? -1 : (ea->thread > eb->thread);
+}
+
+/* Decode one dump, the marker line has been read. */
+static int decode_dump(FILE *in, unsigned long long count)
+{
+    struct mlle_trace_event *events = NULL;
+    unsigned long long i = 0;
+
+    if (count == 0) {
+        return 1;
+    }
+    events = malloc((size_t) count * sizeof(*events));
+    if (events == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+    if (fread(events, sizeof(*events), (size_t) count, in) != count) {
+        fprintf(stderr, "Trace is truncated\n");
+        free(events);
+        return 0;
+    }
+    qsort(events, (size_t) count, sizeof(*events), compare_events);
+
+    for (i = 0; i < count; i++) {
+        printf("%12.3f T%u %-14s %lld %lld %lld\n",
+               (double) (events[i].timestamp - events[0].timestamp) / 1000.0,
+               events[i].thread, mlle_trace_event_name(events[i].id),
+               events[i].args[0], events[i].args[1], events[i].args[2]);
+    }
+
+    free(events);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = NULL;
+    char line[256];
+    int dumps = 0;
+    int result = 0;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <LVE log file>\n", argv[0]);
+        return 1;
+    }
+    in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        int version = 0;
+        unsigned int event_size = 0;
+        unsigned long long count = 0;
+
+        if (strncmp(line, MLLE_TRACE_MARKER " ", strlen(MLLE_TRACE_MARKER) + 1) != 0) {
+            continue;
+        }
+        if (sscanf(line + strlen(MLLE_TRACE_MARKER), "%d %u %llu",
+                   &version, &event_size, &count) != 3
+            || version != MLLE_TRACE_VERSION
+            || event_size != sizeof(struct mlle_trace_event)) {
+            fprintf(stderr, "Unsupported trace format: %s", line);
+            result = 1;
+            break;
+        }
+        printf("# trace %d, %llu events\n", ++dumps, count);
+        if (!decode_dump(in, count)) {
+            result = 1;
+            break;
+        }
+    }
+    fclose(in);
+
+    if (dumps == 0 && result == 0) {
+        fprintf(stderr, "No trace found in %s\n", argv[1]);
+        result = 1;
+    }
+    return result;
+}